@@ -1560,6 +1560,24 @@ static void updateHashChain(Hash* hash, size_t wpos, unsigned hashval, unsigned
   hash->headz[numzeros] = (int)wpos;
 }
 
+/*Adds positions 0..dictsize-1 of in to the hash chains without emitting anything, so that a
+following encodeLZ77 from inpos dictsize can match against them as if they were already
+encoded. Used for a zlib preset dictionary. dictsize must not be larger than windowsize.*/
+static void hash_seed(Hash* hash, const unsigned char* in, size_t insize, size_t dictsize, unsigned windowsize) {
+  size_t pos;
+  unsigned numzeros = 0;
+  for(pos = 0; pos != dictsize; ++pos) {
+    unsigned hashval = getHash(in, insize, pos);
+    if(hashval == 0) {
+      if(numzeros == 0) numzeros = countZeros(in, insize, pos);
+      else if(pos + numzeros > insize || in[pos + numzeros - 1] != 0) --numzeros;
+    } else {
+      numzeros = 0;
+    }
+    updateHashChain(hash, pos & (windowsize - 1), hashval, (unsigned short)numzeros);
+  }
+}
+
 /*
 LZ77-encode the data. Return value is error code. The input are raw bytes, the output
 is in the form of unsigned integers with codes representing for example literal bytes, or
@@ -2050,8 +2068,9 @@ static unsigned deflateFixed(LodePNGBitWriter* writer, Hash* hash,
   return error;
 }
 
-static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
-                                 const LodePNGCompressSettings* settings) {
+/*in[0..inpos) is a preset dictionary: it is not output, but matches may refer back into it*/
+static unsigned lodepng_deflatev_from(ucvector* out, const unsigned char* in, size_t inpos, size_t insize,
+                                      const LodePNGCompressSettings* settings) {
   unsigned error = 0;
   size_t i, blocksize, numdeflateblocks;
   Hash hash;
@@ -2060,24 +2079,29 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
   LodePNGBitWriter_init(&writer, out);
 
   if(settings->btype > 2) return 61;
-  else if(settings->btype == 0) return deflateNoCompression(out, in, insize);
-  else if(settings->btype == 1) blocksize = insize;
+  else if(settings->btype == 0) return deflateNoCompression(out, in + inpos, insize - inpos);
+  else if(settings->btype == 1) blocksize = insize - inpos;
   else /*if(settings->btype == 2)*/ {
     /*on PNGs, deflate blocks of 65-262k seem to give most dense encoding*/
-    blocksize = insize / 8u + 8;
+    blocksize = (insize - inpos) / 8u + 8;
     if(blocksize < 65536) blocksize = 65536;
     if(blocksize > 262144) blocksize = 262144;
   }
 
-  numdeflateblocks = (insize + blocksize - 1) / blocksize;
+  /*blocksize is 0 for empty input with btype 1, which still needs one (empty) block*/
+  numdeflateblocks = blocksize ? (insize - inpos + blocksize - 1) / blocksize : 1;
   if(numdeflateblocks == 0) numdeflateblocks = 1;
 
+  if(inpos > settings->windowsize) return 60; /*error: dictionary larger than the window*/
+
   error = hash_init(&hash, settings->windowsize);
 
   if(!error) {
+    if(settings->use_lz77) hash_seed(&hash, in, insize, inpos, settings->windowsize);
+
     for(i = 0; i != numdeflateblocks && !error; ++i) {
       unsigned final = (i == numdeflateblocks - 1);
-      size_t start = i * blocksize;
+      size_t start = inpos + i * blocksize;
       size_t end = start + blocksize;
       if(end > insize) end = insize;
 
@@ -2091,6 +2115,11 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
   return error;
 }
 
+static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
+                                 const LodePNGCompressSettings* settings) {
+  return lodepng_deflatev_from(out, in, 0, insize, settings);
+}
+
 unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings) {
@@ -2152,9 +2181,11 @@ static unsigned adler32(const unsigned char* data, unsigned len) {
 
 static unsigned lodepng_zlib_decompressv(ucvector* out,
                                          const unsigned char* in, size_t insize,
+                                         const unsigned char* dict, size_t dictsize,
                                          const LodePNGDecompressSettings* settings) {
   unsigned error = 0;
   unsigned CM, CINFO, FDICT;
+  size_t headersize = 2, base = out->size;
 
   if(insize < 2) return 53; /*error, size of zlib data too small*/
   /*read information from zlib header*/
@@ -2176,10 +2207,28 @@ static unsigned lodepng_zlib_decompressv(ucvector* out,
   if(FDICT != 0) {
     /*error: the specification of PNG says about the zlib stream:
       "The additional flags shall not specify a preset dictionary."*/
-    return 26;
+    if(!dict) return 26;
+    if(insize < 6) return 53;
+    /*DICTID is the Adler-32 of the dictionary the stream was compressed with*/
+    if(lodepng_read32bitInt(&in[2]) != adler32(dict, (unsigned)dictsize)) return 123;
+    headersize = 6;
+  } else {
+    dictsize = 0;
   }
 
-  error = inflatev(out, in + 2, insize - 2, settings);
+  if(dictsize) {
+    /*the dictionary is history for back-references, placed in front of the output and removed after*/
+    if(!ucvector_resize(out, base + dictsize)) return 83; /*alloc fail*/
+    lodepng_memcpy(out->data + base, dict, dictsize);
+    error = lodepng_inflatev(out, in + headersize, insize - headersize, settings);
+    if(out->size >= base + dictsize) {
+      size_t i;
+      for(i = base; i + dictsize != out->size; ++i) out->data[i] = out->data[i + dictsize];
+      out->size -= dictsize;
+    }
+  } else {
+    error = inflatev(out, in + headersize, insize - headersize, settings);
+  }
   if(error) return error;
 
   if(!settings->ignore_adler32) {
@@ -2195,7 +2244,17 @@ static unsigned lodepng_zlib_decompressv(ucvector* out,
 unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
                                  size_t insize, const LodePNGDecompressSettings* settings) {
   ucvector v = ucvector_init(*out, *outsize);
-  unsigned error = lodepng_zlib_decompressv(&v, in, insize, settings);
+  unsigned error = lodepng_zlib_decompressv(&v, in, insize, 0, 0, settings);
+  *out = v.data;
+  *outsize = v.size;
+  return error;
+}
+
+unsigned lodepng_zlib_decompress_dict(unsigned char** out, size_t* outsize, const unsigned char* in,
+                                      size_t insize, const unsigned char* dict, size_t dictsize,
+                                      const LodePNGDecompressSettings* settings) {
+  ucvector v = ucvector_init(*out, *outsize);
+  unsigned error = lodepng_zlib_decompressv(&v, in, insize, dict, dictsize, settings);
   *out = v.data;
   *outsize = v.size;
   return error;
@@ -2220,7 +2279,7 @@ static unsigned zlib_decompress(unsigned char** out, size_t* outsize, size_t exp
       ucvector_resize(&v, *outsize + expected_size);
       v.size = *outsize;
     }
-    error = lodepng_zlib_decompressv(&v, in, insize, settings);
+    error = lodepng_zlib_decompressv(&v, in, insize, 0, 0, settings);
     *out = v.data;
     *outsize = v.size;
   }
@@ -2231,36 +2290,56 @@ static unsigned zlib_decompress(unsigned char** out, size_t* outsize, size_t exp
 
 #ifdef LODEPNG_COMPILE_ENCODER
 
-unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
-                               size_t insize, const LodePNGCompressSettings* settings) {
+/*dict may be NULL; otherwise the stream gets FDICT and is deflated with dict as preceding history*/
+static unsigned lodepng_zlib_compressv(unsigned char** out, size_t* outsize, const unsigned char* in,
+                                       size_t insize, const unsigned char* dict, size_t dictsize,
+                                       const LodePNGCompressSettings* settings) {
   size_t i;
   unsigned error;
   unsigned char* deflatedata = 0;
   size_t deflatesize = 0;
-
-  error = deflate(&deflatedata, &deflatesize, in, insize, settings);
+  size_t headersize = dict ? 6 : 2;
+
+  if(dict) {
+    /*only the last window of the dictionary can be reached by back-references*/
+    size_t used = dictsize > settings->windowsize ? settings->windowsize : dictsize;
+    unsigned char* buffer = (unsigned char*)lodepng_malloc(used + insize);
+    if(!buffer) return 83; /*alloc fail*/
+    lodepng_memcpy(buffer, dict + dictsize - used, used);
+    if(insize) lodepng_memcpy(buffer + used, in, insize);
+    {
+      ucvector v = ucvector_init(0, 0);
+      error = lodepng_deflatev_from(&v, buffer, used, used + insize, settings);
+      deflatedata = v.data;
+      deflatesize = v.size;
+    }
+    lodepng_free(buffer);
+  } else {
+    error = deflate(&deflatedata, &deflatesize, in, insize, settings);
+  }
 
   *out = NULL;
   *outsize = 0;
   if(!error) {
-    *outsize = deflatesize + 6;
+    *outsize = deflatesize + headersize + 4;
     *out = (unsigned char*)lodepng_malloc(*outsize);
     if(!*out) error = 83; /*alloc fail*/
   }
 
   if(!error) {
     unsigned ADLER32 = adler32(in, (unsigned)insize);
-    /*zlib data: 1 byte CMF (CM+CINFO), 1 byte FLG, deflate data, 4 byte ADLER32 checksum of the Decompressed data*/
+    /*zlib data: 1 byte CMF (CM+CINFO), 1 byte FLG, [4 byte DICTID,] deflate data, 4 byte ADLER32 checksum of the Decompressed data*/
     unsigned CMF = 120; /*0b01111000: CM 8, CINFO 7. With CINFO 7, any window size up to 32768 can be used.*/
     unsigned FLEVEL = 0;
-    unsigned FDICT = 0;
+    unsigned FDICT = dict ? 1 : 0;
     unsigned CMFFLG = 256 * CMF + FDICT * 32 + FLEVEL * 64;
     unsigned FCHECK = 31 - CMFFLG % 31;
     CMFFLG += FCHECK;
 
     (*out)[0] = (unsigned char)(CMFFLG >> 8);
     (*out)[1] = (unsigned char)(CMFFLG & 255);
-    for(i = 0; i != deflatesize; ++i) (*out)[i + 2] = deflatedata[i];
+    if(dict) lodepng_set32bitInt(&(*out)[2], adler32(dict, (unsigned)dictsize));
+    for(i = 0; i != deflatesize; ++i) (*out)[i + headersize] = deflatedata[i];
     lodepng_set32bitInt(&(*out)[*outsize - 4], ADLER32);
   }
 
@@ -2268,6 +2347,18 @@ unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsig
   return error;
 }
 
+unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
+                               size_t insize, const LodePNGCompressSettings* settings) {
+  return lodepng_zlib_compressv(out, outsize, in, insize, 0, 0, settings);
+}
+
+unsigned lodepng_zlib_compress_dict(unsigned char** out, size_t* outsize, const unsigned char* in,
+                                    size_t insize, const unsigned char* dict, size_t dictsize,
+                                    const LodePNGCompressSettings* settings) {
+  if(!dict) return 87; /*a dictionary is required*/
+  return lodepng_zlib_compressv(out, outsize, in, insize, dict, dictsize, settings);
+}
+
 /* compress using the default or custom zlib function */
 static unsigned zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
                               size_t insize, const LodePNGCompressSettings* settings) {
@@ -7013,6 +7104,7 @@ const char* lodepng_error_text(unsigned code) {
     case 120: return "invalid cLLI chunk size";
     case 121: return "invalid chunk type name: may only contain [a-zA-Z]";
     case 122: return "invalid chunk type name: third character must be uppercase";
+    case 123: return "zlib preset dictionary does not match the DICTID in the header";
   }
   return "unknown error code";
 }
@@ -1104,7 +1104,8 @@ unsigned lodepng_crc32(const unsigned char* buf, size_t len);
 /*
 This zlib part can be used independently to zlib compress and decompress a
 buffer. It cannot be used to create gzip files however, and it only supports the
-part of zlib that is required for PNG, it does not support dictionaries.
+part of zlib that is required for PNG, plus preset dictionaries (FDICT) through the
+_dict functions below. PNG itself does not allow preset dictionaries.
 */
 
 #ifdef LODEPNG_COMPILE_DECODER
@@ -1122,6 +1123,17 @@ buffer and *outsize its size in bytes. out must be freed by user after usage.
 unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize,
                                  const unsigned char* in, size_t insize,
                                  const LodePNGDecompressSettings* settings);
+
+/*
+Same as lodepng_zlib_decompress, but also accepts streams with a preset dictionary
+(FDICT), which must be the dict they were compressed with: error 123 if its Adler-32
+does not match the DICTID in the header. Streams without FDICT decode as usual.
+A custom_inflate in the settings is not used for FDICT streams.
+*/
+unsigned lodepng_zlib_decompress_dict(unsigned char** out, size_t* outsize,
+                                      const unsigned char* in, size_t insize,
+                                      const unsigned char* dict, size_t dictsize,
+                                      const LodePNGDecompressSettings* settings);
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -1136,6 +1148,19 @@ unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize,
                                const unsigned char* in, size_t insize,
                                const LodePNGCompressSettings* settings);
 
+/*
+Same as lodepng_zlib_compress, but with a preset dictionary (FDICT): the deflate stream
+may refer back into dict as if it came right before the input, which makes short inputs
+that share strings with dict much smaller. The header carries the Adler-32 of dict as
+DICTID. Only the last settings->windowsize bytes of dict are used, so set windowsize to
+32768 for large dictionaries. The matching decoder is lodepng_zlib_decompress_dict (or
+zlib's inflateSetDictionary). A custom_deflate in the settings is not used.
+*/
+unsigned lodepng_zlib_compress_dict(unsigned char** out, size_t* outsize,
+                                    const unsigned char* in, size_t insize,
+                                    const unsigned char* dict, size_t dictsize,
+                                    const LodePNGCompressSettings* settings);
+
 /*
 Find length-limited Huffman code for given frequencies. This function is in the
 public interface only for tests, it's used internally by lodepng_deflate.
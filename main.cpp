@@ -1,44 +1,191 @@
 #include <windows.h>
 #include <shellapi.h>
 
+#include <algorithm>
+#include <array>
 #include <string>
 #include <string_view>
 #include <vector>
 #include <sstream>
 #include <memory>
 #include <type_traits>
+#include <utility>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 
 #include "qrcodegen.hpp"
-#include "lodepng.h"
+#include "qrcost.hpp"
+#include "qrdelta.hpp"
+#include "qrexport.hpp"
+#include "qrpack.hpp"
 
 class SimpleQRCodeGenerator final {
 public:
+    // Where generated images go. Single codes are written as uncompressed 1-bit BMP, which is
+    // quick to write and to show; animations and colour layers need PNG. The extensions pick
+    // the viewer that opens the file.
+    struct OutputFiles {
+        std::wstring bitmap;
+        std::wstring png;
+    };
+
+    // Estimates with qrcost.model from the executable's directory when there is one, such as a
+    // model `qrtool bench-cost` calibrated on this machine, and with the built-in model otherwise
+    SimpleQRCodeGenerator() noexcept
+        : estimator_{loadCostModel()} {}
+
+    // Codes from this version up have modules too fine for many phone cameras to resolve
+    // from a screen, so the window warns about them
+    static constexpr int denseVersion = 30;
+
+    // The version generate() will choose for these segments, found without encoding them;
+    // 0 if they do not fit one code.
+    [[nodiscard]]
+    int predictVersion(const std::vector<qrcodegen::QrSegment>& segs, std::size_t payloadBytes) const noexcept {
+        try {
+            const auto estimate = estimator_.estimate(segs, chooseErrorCorrection(payloadBytes));
+            return estimate.fits ? estimate.version : 0;
+        }
+        catch (...) {
+            return 0;
+        }
+    }
+
+    // Whether a payload of this many bytes is drawn as a single code rather than an animation
+    [[nodiscard]]
+    static constexpr bool fitsOneCode(std::size_t payloadBytes) noexcept {
+        return payloadBytes <= maxPayloadSizeUtf8;
+    }
+
     [[nodiscard]]
-    bool generate(const std::string& textUtf8, const std::wstring& filename) const noexcept {
+    bool generate(const std::string& textUtf8, const OutputFiles& files) const noexcept {
         if (textUtf8.empty()) {
             return false;
         }
         if (textUtf8.length() > maxPayloadSizeUtf8) {
+            return generateAnimated(textUtf8, files);
+        }
+
+        try {
+            return generate(qrcodegen::QrSegment::makeSegments(textUtf8.c_str()), textUtf8.length(), files);
+        }
+        catch (...) {
+            return false;
+        }
+    }
+
+    // Encodes ready-made segments as one code, e.g. a legacy charset behind an ECI designator.
+    // payloadBytes is the encoded text length, which drives the error correction choice.
+    [[nodiscard]]
+    bool generate(const std::vector<qrcodegen::QrSegment>& segs, std::size_t payloadBytes,
+                  const OutputFiles& files) const noexcept {
+        if (payloadBytes == 0 || payloadBytes > maxPayloadSizeUtf8) {
             return false;
         }
 
         try {
-            const auto eccLevel = chooseErrorCorrection(textUtf8);
-            const qrcodegen::QrCode qr = qrcodegen::QrCode::encodeText(textUtf8.c_str(), eccLevel);
+            const auto eccLevel = chooseErrorCorrection(payloadBytes);
+            const auto result = qrcodegen::QrCode::tryEncodeSegments(segs, eccLevel);
+            if (!result) {
+                return false;
+            }
+            const qrcodegen::QrCode& qr = result.value();
 
             const int  scale  = calculateScale(qr.getSize());
             constexpr int border = 4;
 
-            auto pngData = generatePNG(qr, scale, border);
+            // Shown once and thrown away, so no PNG compression
+            const auto bmpData = qrexport::encodeBmp(qr, scale, border);
+            if (!saveFile(files.bitmap, bmpData)) {
+                return false;
+            }
+
+            (void)openWithShellExecute(files.bitmap);
+            return true;
+        }
+        catch (...) {
+            return false;
+        }
+    }
+
+    // Text too long for one code is split across codes of one moderate version, which
+    // stay easy to scan, and shown as the looping frames of a single animated PNG.
+    [[nodiscard]]
+    bool generateAnimated(const std::string& textUtf8, const OutputFiles& files) const noexcept {
+        try {
+            const auto codes = qrexport::encodeParts(textUtf8, animationVersion, animationEcc);
+            if (codes.empty() || codes.size() > maxAnimationFrames) {
+                return false;
+            }
+
+            const int  scale  = calculateScale(codes[0].getSize());
+            constexpr int border = 4;
+
+            auto pngData = qrexport::encodeApng(codes, scale, border, animationFramesPerSecond);
             if (pngData.empty()) {
                 return false;
             }
-            if (!savePng(filename, pngData)) {
+            if (!saveFile(files.png, pngData)) {
                 return false;
             }
 
-            (void)openWithShellExecute(filename);
+            (void)openWithShellExecute(files.png);
+            return true;
+        }
+        catch (...) {
+            return false;
+        }
+    }
+
+    // Experimental: splits the text into three parts and encodes them as three codes of
+    // the same version in the R, G and B channels of one image. The receiving side
+    // separates the layers with `qrtool split-rgb` and decodes each part in order.
+    [[nodiscard]]
+    bool generateColor(const std::string& textUtf8, const OutputFiles& files) const noexcept {
+        if (textUtf8.empty()) {
+            return false;
+        }
+        if (textUtf8.length() > maxPayloadSizeUtf8 * 3) {
+            return false;
+        }
+
+        try {
+            const auto parts = splitUtf8(textUtf8);
+            const auto longest = std::max_element(parts.begin(), parts.end(),
+                [](const std::string& a, const std::string& b) { return a.length() < b.length(); });
+            const auto eccLevel = chooseErrorCorrection(longest->length());
+
+            // All layers must have the same size, so encode each at the largest version needed
+            std::vector<std::vector<qrcodegen::QrSegment>> segments;
+            int version = qrcodegen::QrCode::MIN_VERSION;
+            for (const auto& part : parts) {
+                segments.push_back(qrcodegen::QrSegment::makeSegments(part.c_str()));
+                const int needed = qrcodegen::QrCode::getMinVersion(segments.back(), eccLevel);
+                if (needed == -1) {
+                    return false;
+                }
+                version = std::max(version, needed);
+            }
+            std::vector<qrcodegen::QrCode> layers;
+            for (const auto& segs : segments) {
+                layers.push_back(qrcodegen::QrCode::encodeSegments(segs, eccLevel, version, version));
+            }
+
+            const int  scale  = calculateScale(layers[0].getSize());
+            constexpr int border = 4;
+
+            auto pngData = qrexport::encodeColorPng({&layers[0], &layers[1], &layers[2]}, scale, border);
+            if (pngData.empty()) {
+                return false;
+            }
+            if (!saveFile(files.png, pngData)) {
+                return false;
+            }
+
+            (void)openWithShellExecute(files.png);
             return true;
         }
         catch (...) {
@@ -47,6 +194,28 @@ public:
     }
 
 private:
+    qrcost::Estimator estimator_;
+
+    [[nodiscard]]
+    static qrcost::CostModel loadCostModel() noexcept {
+        try {
+            wchar_t exePath[MAX_PATH] = {};
+            const DWORD len = ::GetModuleFileNameW(nullptr, exePath, MAX_PATH);
+            if (len == 0 || len >= MAX_PATH) {
+                return {};
+            }
+            const auto path = std::filesystem::path(exePath).replace_filename(L"qrcost.model");
+            std::error_code error;
+            if (!std::filesystem::is_regular_file(path, error)) {
+                return {};
+            }
+            return qrcost::CostModel::load(path);
+        }
+        catch (...) {
+            return {};  // A malformed model is ignored rather than keeping the window from opening
+        }
+    }
+
     struct HandleCloser {
         void operator()(HANDLE h) const noexcept {
             if (h && h != INVALID_HANDLE_VALUE) {
@@ -72,9 +241,14 @@ private:
 
     static constexpr std::size_t maxPayloadSizeUtf8 = 2953;
 
+    // Multi-code animation: version 20 at level M holds 666 bytes per frame
+    static constexpr int animationVersion = 20;
+    static constexpr qrcodegen::QrCode::Ecc animationEcc = qrcodegen::QrCode::Ecc::MEDIUM;
+    static constexpr int animationFramesPerSecond = 2;
+    static constexpr std::size_t maxAnimationFrames = 64;
+
     [[nodiscard]]
-    qrcodegen::QrCode::Ecc chooseErrorCorrection(const std::string& text) const noexcept {
-        const auto length = text.length();
+    qrcodegen::QrCode::Ecc chooseErrorCorrection(std::size_t length) const noexcept {
         if (length <= 119)  return qrcodegen::QrCode::Ecc::HIGH;
 		if (length <= 482)  return qrcodegen::QrCode::Ecc::QUARTILE;
         if (length <= 2331)  return qrcodegen::QrCode::Ecc::MEDIUM;
@@ -92,50 +266,27 @@ private:
         return baseScale;
     }
 
+    // Splits UTF-8 text into three parts of nearly equal byte length, cutting only
+    // between code points so that each part is valid UTF-8 on its own.
     [[nodiscard]]
-    std::vector<unsigned char> generatePNG(const qrcodegen::QrCode& qr, int scale, int border) const {
-        const int size    = qr.getSize();
-        const int imgSize = (size + border * 2) * scale;
-
-        std::vector<unsigned char> image(static_cast<std::size_t>(imgSize) * imgSize * 4u, 255);
-
-        for (int y = 0; y < imgSize; ++y) {
-            for (int x = 0; x < imgSize; ++x) {
-                const int qrX = (x / scale) - border;
-                const int qrY = (y / scale) - border;
-
-                const bool isBlack =
-                    (qrX >= 0 && qrX < size && qrY >= 0 && qrY < size) &&
-                    qr.getModule(qrX, qrY);
-
-                if (isBlack) {
-                    const std::size_t index =
-                        (static_cast<std::size_t>(y) * imgSize + x) * 4u;
-                    image[index + 0] = 0;
-                    image[index + 1] = 0;
-                    image[index + 2] = 0;
-                    image[index + 3] = 255;
-                }
+    static std::array<std::string, 3> splitUtf8(const std::string& text) {
+        std::array<std::string, 3> parts;
+        std::size_t begin = 0;
+        for (std::size_t i = 0; i < parts.size(); ++i) {
+            std::size_t end = text.length() * (i + 1) / parts.size();
+            while (end < text.length() && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) {
+                ++end;
             }
+            end = std::max(end, begin);
+            parts[i] = text.substr(begin, end - begin);
+            begin = end;
         }
-
-        std::vector<unsigned char> pngData;
-        const unsigned error = lodepng::encode(
-            pngData,
-            image,
-            static_cast<unsigned>(imgSize),
-            static_cast<unsigned>(imgSize)
-        );
-
-        if (error != 0u) {
-            return {};
-        }
-        return pngData;
+        return parts;
     }
 
     [[nodiscard]]
-    bool savePng(const std::wstring& filename, const std::vector<unsigned char>& pngData) const {
-        if (pngData.empty()) return false;
+    bool saveFile(const std::wstring& filename, const std::vector<unsigned char>& data) const {
+        if (data.empty()) return false;
 
         unique_handle file = makeFileHandle(filename);
         if (!file || file.get() == INVALID_HANDLE_VALUE) {
@@ -143,10 +294,10 @@ private:
         }
 
         DWORD bytesWritten = 0;
-        const DWORD dataSize = static_cast<DWORD>(pngData.size());
+        const DWORD dataSize = static_cast<DWORD>(data.size());
         const BOOL ok = ::WriteFile(
             file.get(),
-            pngData.data(),
+            data.data(),
             dataSize,
             &bytesWritten,
             nullptr
@@ -169,6 +320,150 @@ private:
     }
 };
 
+// Optional pre-encode stage that shrinks the payload: CRLF line endings from the EDIT control
+// become LF, trailing whitespace can be trimmed from each line, and the text is re-encoded in a
+// legacy charset behind an ECI designator when that needs fewer bits than UTF-8.
+class PayloadMinimizer final {
+public:
+    struct Options {
+        bool normalizeNewlines      = true;
+        bool trimTrailingWhitespace = false;
+        bool allowLegacyCharset     = false;
+    };
+
+    struct Result {
+        std::string utf8;                              // Normalized text, for paths that need UTF-8
+        std::vector<qrcodegen::QrSegment> segments;    // Cheapest encoding found
+        std::size_t originalBytes = 0;                 // UTF-8 length of the unmodified text
+        std::size_t encodedBytes  = 0;                 // Length of the chosen encoding
+        const wchar_t* charset    = L"UTF-8";
+    };
+
+    [[nodiscard]]
+    static Result minimize(const std::wstring& text, const Options& options) {
+        Result result;
+        result.originalBytes = toMultiByte(text, CP_UTF8, nullptr).length();
+
+        const std::wstring normalized = normalize(text, options);
+        result.utf8 = toMultiByte(normalized, CP_UTF8, nullptr);
+        result.segments = qrcodegen::QrSegment::makeSegments(result.utf8.c_str());
+        result.encodedBytes = result.utf8.length();
+        if (!options.allowLegacyCharset || result.utf8.empty()) {
+            return result;
+        }
+
+        // Compare bit costs at the widest character count fields, which is where it matters most
+        constexpr int version = qrcodegen::QrCode::MAX_VERSION;
+        int bestBits = qrcodegen::QrSegment::getTotalBits(result.segments, version);
+        for (const auto& charset : legacyCharsets) {
+            bool lossy = false;
+            const std::string bytes = toMultiByte(normalized, charset.codePage, &lossy);
+            if (lossy || bytes.empty()) {
+                continue;
+            }
+            std::vector<qrcodegen::QrSegment> segs{
+                qrcodegen::QrSegment::makeEci(charset.eci),
+                qrcodegen::QrSegment::makeBytes(std::vector<std::uint8_t>(bytes.begin(), bytes.end()))
+            };
+            const int bits = qrcodegen::QrSegment::getTotalBits(segs, version);
+            if (bits != -1 && (bestBits == -1 || bits < bestBits)) {
+                bestBits = bits;
+                result.segments = std::move(segs);
+                result.encodedBytes = bytes.length();
+                result.charset = charset.name;
+            }
+        }
+        return result;
+    }
+
+    // Converts UTF-16 to the given Windows code page. If lossy is given, it is set when some
+    // character has no exact representation (CP_UTF8 is always exact and takes no flag).
+    [[nodiscard]]
+    static std::string toMultiByte(const std::wstring& wstr, UINT codePage, bool* lossy) {
+        if (wstr.empty()) return {};
+
+        const DWORD flags = codePage == CP_UTF8 ? 0 : WC_NO_BEST_FIT_CHARS;
+        BOOL usedDefault = FALSE;
+        BOOL* const usedDefaultPtr = codePage == CP_UTF8 ? nullptr : &usedDefault;
+        const int len = ::WideCharToMultiByte(
+            codePage,
+            flags,
+            wstr.c_str(),
+            static_cast<int>(wstr.size()),
+            nullptr,
+            0,
+            nullptr,
+            usedDefaultPtr
+        );
+        if (len <= 0) return {};
+
+        std::string bytes(static_cast<std::size_t>(len), '\0');
+        ::WideCharToMultiByte(
+            codePage,
+            flags,
+            wstr.c_str(),
+            static_cast<int>(wstr.size()),
+            bytes.data(),
+            len,
+            nullptr,
+            usedDefaultPtr
+        );
+        if (lossy) {
+            *lossy = usedDefault != FALSE;
+        }
+        return bytes;
+    }
+
+private:
+    struct LegacyCharset {
+        UINT           codePage;
+        long           eci;
+        const wchar_t* name;
+    };
+
+    // ECI 29 is GB2312, which decoders read as GBK/GB18030; ECI 3 is ISO-8859-1
+    static constexpr LegacyCharset legacyCharsets[] = {
+        {936,   29, L"GBK"},
+        {28591,  3, L"ISO-8859-1"},
+    };
+
+    [[nodiscard]]
+    static std::wstring normalize(const std::wstring& text, const Options& options) {
+        std::wstring out;
+        out.reserve(text.size());
+        std::size_t lineStart = 0;
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            const wchar_t c = text[i];
+            const bool crlf = c == L'\r' && i + 1 < text.size() && text[i + 1] == L'\n';
+            if (c == L'\n' || crlf) {
+                if (options.trimTrailingWhitespace) {
+                    trimEnd(out, lineStart);
+                }
+                if (crlf && !options.normalizeNewlines) {
+                    out += L'\r';
+                }
+                out += L'\n';
+                i += crlf ? 1 : 0;
+                lineStart = out.size();
+            } else {
+                out += c;
+            }
+        }
+        if (options.trimTrailingWhitespace) {
+            trimEnd(out, lineStart);
+        }
+        return out;
+    }
+
+    static void trimEnd(std::wstring& text, std::size_t lineStart) {
+        while (text.size() > lineStart && (text.back() == L' ' || text.back() == L'\t')) {
+            text.pop_back();
+        }
+    }
+};
+
+constexpr PayloadMinimizer::LegacyCharset PayloadMinimizer::legacyCharsets[];
+
 class QrController final {
 public:
     explicit QrController(HINSTANCE hInstance) noexcept
@@ -176,10 +471,17 @@ public:
 
     [[nodiscard]]
     bool initialize() {
-        return initTempPngPath();
+        return initTempPaths();
     }
 
-    void onGenerate(HWND hWndMain, HWND hEdit, HWND hStatus) {
+    struct GenerateOptions {
+        bool colorLayers   = false;
+        bool minimizeText  = false;   // CRLF to LF and trailing whitespace trimming
+        bool legacyCharset = false;   // GBK or ISO-8859-1 with ECI when smaller than UTF-8
+        bool deltaHistory  = false;   // Send a diff against an earlier revision when smaller
+    };
+
+    void onGenerate(HWND hWndMain, HWND hEdit, HWND hStatus, const GenerateOptions& options) {
         const int len = ::GetWindowTextLengthW(hEdit);
         if (len <= 0) {
             ::MessageBoxW(hWndMain, L"请输入要生成二维码的文本。", L"提示", MB_ICONINFORMATION);
@@ -190,20 +492,60 @@ public:
         ::GetWindowTextW(hEdit, textW.data(), len + 1);
         textW.resize(static_cast<std::size_t>(len));
 
-        const std::string textUtf8 = wstringToUtf8(textW);
-        if (textUtf8.empty()) {
-            ::MessageBoxW(hWndMain, L"文本编码为 UTF-8 时失败。", L"错误", MB_ICONERROR);
+        PayloadMinimizer::Options minimizerOptions;
+        minimizerOptions.normalizeNewlines      = options.minimizeText;
+        minimizerOptions.trimTrailingWhitespace = options.minimizeText;
+        // The colour and multi-code paths split UTF-8 text, so they keep UTF-8
+        minimizerOptions.allowLegacyCharset     = options.legacyCharset && !options.colorLayers;
+        const PayloadMinimizer::Result payload = PayloadMinimizer::minimize(textW, minimizerOptions);
+        if (payload.utf8.empty()) {
+            if (options.minimizeText) {
+                ::MessageBoxW(hWndMain, L"精简后文本为空。", L"提示", MB_ICONINFORMATION);
+            } else {
+                ::MessageBoxW(hWndMain, L"文本编码为 UTF-8 时失败。", L"错误", MB_ICONERROR);
+            }
             return;
         }
 
-        if (tempPngPath_.empty()) {
+        if (tempFiles_.bitmap.empty() || tempFiles_.png.empty()) {
             ::MessageBoxW(hWndMain, L"临时文件路径未初始化。", L"错误", MB_ICONERROR);
             return;
         }
 
         ::SetWindowTextW(hStatus, L"正在生成二维码...");
 
-        const bool ok = generator_.generate(textUtf8, tempPngPath_);
+        std::vector<std::uint8_t> delta;
+        if (options.deltaHistory && !options.colorLayers) {
+            delta = makeDeltaPayload(payload.utf8, payload.encodedBytes);
+        }
+
+        // Predicted before encoding, so that the status line says why a large code will be hard to scan
+        int version = 0;
+        if (!delta.empty()) {
+            version = generator_.predictVersion({qrcodegen::QrSegment::makeBytes(delta)}, delta.size());
+        } else if (!options.colorLayers && SimpleQRCodeGenerator::fitsOneCode(payload.encodedBytes)) {
+            version = generator_.predictVersion(payload.segments, payload.encodedBytes);
+        }
+        std::wstring denseNote;
+        if (version >= SimpleQRCodeGenerator::denseVersion) {
+            denseNote = L"（版本 " + std::to_wstring(version) + L"，模块较密，部分设备可能难以扫描）";
+            ::SetWindowTextW(hStatus, (L"正在生成二维码" + denseNote + L"...").c_str());
+        }
+
+        bool ok = false;
+        bool singleCode = false;
+        if (options.colorLayers) {
+            ok = generator_.generateColor(payload.utf8, tempFiles_);
+        } else if (!delta.empty()) {
+            ok = generator_.generate({qrcodegen::QrSegment::makeBytes(delta)}, delta.size(), tempFiles_);
+            singleCode = true;
+        } else if (SimpleQRCodeGenerator::fitsOneCode(payload.encodedBytes)) {
+            ok = generator_.generate(payload.segments, payload.encodedBytes, tempFiles_);
+            singleCode = true;
+        } else {
+            ok = generator_.generate(payload.utf8, tempFiles_);
+        }
+        bitmapShown_ = ok && singleCode;
 
         if (!ok) {
             ::SetWindowTextW(hStatus, L"生成二维码失败。");
@@ -211,56 +553,131 @@ public:
             return;
         }
 
+        if (options.deltaHistory) {
+            storeRevision(payload.utf8);
+        }
+
+        if (!delta.empty()) {
+            std::wstringstream ss;
+            ss << L"二维码生成完成，图片已打开。增量发送 " << delta.size() << L" 字节（全文 "
+               << payload.encodedBytes << L" 字节），接收端需用 qrtool apply 还原。" << denseNote;
+            ::SetWindowTextW(hStatus, ss.str().c_str());
+            return;
+        }
+
+        if (options.minimizeText || options.legacyCharset) {
+            const std::size_t usedBytes = options.colorLayers ? payload.utf8.length() : payload.encodedBytes;
+            std::wstringstream ss;
+            ss << L"二维码生成完成，图片已打开。编码 " << (options.colorLayers ? L"UTF-8" : payload.charset)
+               << L"，" << usedBytes << L" 字节（节省 " << (payload.originalBytes - usedBytes) << L" 字节）。" << denseNote;
+            ::SetWindowTextW(hStatus, ss.str().c_str());
+            return;
+        }
+
         ::SetWindowTextW(
             hStatus,
-            L"二维码生成完成，图片已打开（如未自动打开，可到系统临时目录查看）。"
+            (L"二维码生成完成，图片已打开（如未自动打开，可到系统临时目录查看）。" + denseNote).c_str()
         );
     }
 
+    // Puts the code on display on the clipboard as a CF_DIB. The BMP file written for display
+    // is that DIB behind a 14-byte file header, so it is read back rather than rendered again.
+    void onCopy(HWND hWndMain, HWND hStatus) {
+        if (!bitmapShown_) {
+            ::MessageBoxW(hWndMain, L"请先生成单个二维码（动画与彩色图片不支持复制）。", L"提示", MB_ICONINFORMATION);
+            return;
+        }
+
+        std::ifstream in(std::filesystem::path(tempFiles_.bitmap), std::ios::binary);
+        const std::vector<char> bmp{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+        constexpr std::size_t fileHeaderSize = 14;
+        if (bmp.size() <= fileHeaderSize || !copyDibToClipboard(hWndMain, bmp.data() + fileHeaderSize,
+                                                                bmp.size() - fileHeaderSize)) {
+            ::MessageBoxW(hWndMain, L"复制到剪贴板失败。", L"错误", MB_ICONERROR);
+            return;
+        }
+        ::SetWindowTextW(hStatus, L"二维码图片已复制到剪贴板。");
+    }
+
     void onDestroy() {
-        if (!tempPngPath_.empty()) {
-            ::DeleteFileW(tempPngPath_.c_str());
-            tempPngPath_.clear();
+        for (std::wstring* path : {&tempFiles_.bitmap, &tempFiles_.png}) {
+            if (!path->empty()) {
+                ::DeleteFileW(path->c_str());
+                path->clear();
+            }
         }
+        bitmapShown_ = false;
     }
 
 private:
     HINSTANCE   hInstance_   = nullptr;
-    std::wstring tempPngPath_;
+    SimpleQRCodeGenerator::OutputFiles tempFiles_;
+    bool        bitmapShown_ = false;   // The last image shown is tempFiles_.bitmap
     SimpleQRCodeGenerator generator_;
 
     [[nodiscard]]
-    static std::string wstringToUtf8(const std::wstring& wstr) {
-        if (wstr.empty()) return {};
+    static bool copyDibToClipboard(HWND owner, const char* dib, std::size_t size) {
+        HGLOBAL hMem = ::GlobalAlloc(GMEM_MOVEABLE, size);
+        if (!hMem) {
+            return false;
+        }
+        void* dst = ::GlobalLock(hMem);
+        if (!dst) {
+            ::GlobalFree(hMem);
+            return false;
+        }
+        std::memcpy(dst, dib, size);
+        ::GlobalUnlock(hMem);
 
-        const int len = ::WideCharToMultiByte(
-            CP_UTF8,
-            0,
-            wstr.c_str(),
-            static_cast<int>(wstr.size()),
-            nullptr,
-            0,
-            nullptr,
-            nullptr
-        );
-        if (len <= 0) return {};
+        if (!::OpenClipboard(owner)) {
+            ::GlobalFree(hMem);
+            return false;
+        }
+        ::EmptyClipboard();
+        // On success the clipboard owns the memory
+        const bool ok = ::SetClipboardData(CF_DIB, hMem) != nullptr;
+        ::CloseClipboard();
+        if (!ok) {
+            ::GlobalFree(hMem);
+        }
+        return ok;
+    }
 
-        std::string utf8(static_cast<std::size_t>(len), '\0');
-        ::WideCharToMultiByte(
-            CP_UTF8,
-            0,
-            wstr.c_str(),
-            static_cast<int>(wstr.size()),
-            utf8.data(),
-            len,
-            nullptr,
-            nullptr
-        );
-        return utf8;
+    // Returns the diff against the closest revision in the delta history, packed when that helps,
+    // or an empty vector if it would not be smaller than the full payload of fullBytes.
+    [[nodiscard]]
+    static std::vector<std::uint8_t> makeDeltaPayload(const std::string& textUtf8, std::size_t fullBytes) noexcept {
+        try {
+            const qrdelta::History history(qrdelta::History::defaultDirectory());
+            std::vector<std::uint8_t> delta = history.bestDelta(textUtf8);
+            if (delta.empty()) {
+                return {};
+            }
+            std::vector<std::uint8_t> packed = qrpack::compress(std::string(delta.begin(), delta.end()));
+            if (packed.size() < delta.size()) {
+                delta = std::move(packed);
+            }
+            if (delta.size() >= fullBytes) {
+                return {};
+            }
+            return delta;
+        }
+        catch (...) {
+            return {};
+        }
+    }
+
+    static void storeRevision(const std::string& textUtf8) noexcept {
+        try {
+            qrdelta::History history(qrdelta::History::defaultDirectory());
+            (void)history.store(textUtf8);
+        }
+        catch (...) {
+        }
     }
 
     [[nodiscard]]
-    bool initTempPngPath() {
+    bool initTempPaths() {
         wchar_t tempPath[MAX_PATH] = {};
         const DWORD len = ::GetTempPathW(MAX_PATH, tempPath);
         if (len == 0 || len > MAX_PATH) {
@@ -279,12 +696,12 @@ private:
         if (dotPos != std::wstring::npos) {
             path.erase(dotPos);
         }
-        path += L".png";
+        tempFiles_.bitmap = path + L".bmp";
+        tempFiles_.png    = path + L".png";
+        ::DeleteFileW(tempFiles_.bitmap.c_str());
+        ::DeleteFileW(tempFiles_.png.c_str());
 
-        ::DeleteFileW(path.c_str());
-
-        tempPngPath_ = std::move(path);
-        return !tempPngPath_.empty();
+        return !path.empty();
     }
 };
 
@@ -321,14 +738,24 @@ private:
     enum class ControlId : int {
         Edit   = 1001,
         Button = 1002,
-        Status = 1003
+        Status = 1003,
+        Color  = 1004,
+        Minify = 1005,
+        Legacy = 1006,
+        Delta  = 1007,
+        Copy   = 1008
     };
 
     HINSTANCE   hInstance_   = nullptr;
     HWND        hWndMain_    = nullptr;
     HWND        hEdit_       = nullptr;
     HWND        hButton_     = nullptr;
+    HWND        hCopy_       = nullptr;
     HWND        hStatus_     = nullptr;
+    HWND        hColor_      = nullptr;
+    HWND        hMinify_     = nullptr;
+    HWND        hLegacy_     = nullptr;
+    HWND        hDelta_      = nullptr;
     QrController& controller_;
 
     static constexpr wchar_t kClassName_[] = L"QrWin32ClientWindow";
@@ -442,6 +869,61 @@ private:
             nullptr
         );
 
+        hCopy_ = ::CreateWindowW(
+            L"BUTTON",
+            L"复制图片",
+            WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+            120, 220, 100, 30,
+            hWnd,
+            reinterpret_cast<HMENU>(static_cast<int>(ControlId::Copy)),
+            hInstance_,
+            nullptr
+        );
+
+        hColor_ = ::CreateWindowW(
+            L"BUTTON",
+            L"彩色三层（实验）",
+            WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX,
+            230, 220, 150, 30,
+            hWnd,
+            reinterpret_cast<HMENU>(static_cast<int>(ControlId::Color)),
+            hInstance_,
+            nullptr
+        );
+
+        hMinify_ = ::CreateWindowW(
+            L"BUTTON",
+            L"精简文本",
+            WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX,
+            390, 220, 100, 30,
+            hWnd,
+            reinterpret_cast<HMENU>(static_cast<int>(ControlId::Minify)),
+            hInstance_,
+            nullptr
+        );
+
+        hLegacy_ = ::CreateWindowW(
+            L"BUTTON",
+            L"GBK 编码（ECI）",
+            WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX,
+            500, 220, 160, 30,
+            hWnd,
+            reinterpret_cast<HMENU>(static_cast<int>(ControlId::Legacy)),
+            hInstance_,
+            nullptr
+        );
+
+        hDelta_ = ::CreateWindowW(
+            L"BUTTON",
+            L"增量发送",
+            WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX,
+            670, 220, 100, 30,
+            hWnd,
+            reinterpret_cast<HMENU>(static_cast<int>(ControlId::Delta)),
+            hInstance_,
+            nullptr
+        );
+
         hStatus_ = ::CreateWindowW(
             L"STATIC",
             L"就绪。",
@@ -455,7 +937,7 @@ private:
     }
 
     void onSize(int width, int height) {
-        if (!hEdit_ || !hButton_ || !hStatus_) return;
+        if (!hEdit_ || !hButton_ || !hCopy_ || !hStatus_ || !hColor_ || !hMinify_ || !hLegacy_ || !hDelta_) return;
 
         constexpr int margin       = 10;
         constexpr int buttonHeight = 30;
@@ -479,15 +961,28 @@ private:
             TRUE
         );
 
+        // One row of controls under the edit box, laid out left to right
         const int buttonTop = editBottom + margin;
-        ::MoveWindow(
-            hButton_,
-            margin,
-            buttonTop,
-            100,
-            buttonHeight,
-            TRUE
-        );
+        const std::pair<HWND, int> rowControls[] = {
+            {hButton_, 100},
+            {hCopy_,   100},
+            {hColor_,  150},
+            {hMinify_, 100},
+            {hLegacy_, 160},
+            {hDelta_,  100},
+        };
+        int left = margin;
+        for (const auto& [hControl, controlWidth] : rowControls) {
+            ::MoveWindow(
+                hControl,
+                left,
+                buttonTop,
+                controlWidth,
+                buttonHeight,
+                TRUE
+            );
+            left += controlWidth + margin;
+        }
 
         const int statusTop = buttonTop + buttonHeight + margin;
         ::MoveWindow(
@@ -503,13 +998,25 @@ private:
     void onCommand(int id, int code) {
         const auto cid = static_cast<ControlId>(id);
         if (cid == ControlId::Button && code == BN_CLICKED) {
-            controller_.onGenerate(hWndMain_, hEdit_, hStatus_);
+            QrController::GenerateOptions options;
+            options.colorLayers   = isChecked(hColor_);
+            options.minimizeText  = isChecked(hMinify_);
+            options.legacyCharset = isChecked(hLegacy_);
+            options.deltaHistory  = isChecked(hDelta_);
+            controller_.onGenerate(hWndMain_, hEdit_, hStatus_, options);
+        } else if (cid == ControlId::Copy && code == BN_CLICKED) {
+            controller_.onCopy(hWndMain_, hStatus_);
         }
     }
 
     void onDestroy() {
         controller_.onDestroy();
     }
+
+    [[nodiscard]]
+    static bool isChecked(HWND hCheckBox) {
+        return ::SendMessageW(hCheckBox, BM_GETCHECK, 0, 0) == BST_CHECKED;
+    }
 };
 
 constexpr wchar_t MainWindow::kClassName_[];
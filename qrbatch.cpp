@@ -0,0 +1,414 @@
+#include "qrbatch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <optional>
+#include <utility>
+
+#include "qrdelta.hpp"
+#include "qrexport.hpp"
+
+namespace qrbatch {
+
+namespace {
+
+constexpr int numMasks = 8;
+
+// The scheduler and worker index of the calling thread, so that spawn() from inside a task
+// can push to its own deque
+thread_local const Scheduler* currentScheduler = nullptr;
+thread_local unsigned         currentWorker    = 0;
+
+using Metadata = std::shared_ptr<const qrexport::PngMetadata>;
+
+// The text chunks options.embed asks for, or null for none.
+[[nodiscard]]
+Metadata makeMetadata(const std::string& payload, const BatchOptions& options) {
+    if (options.embed == BatchOptions::Embed::Nothing) {
+        return nullptr;
+    }
+    auto metadata = std::make_shared<qrexport::PngMetadata>();
+    metadata->payloadHash = qrdelta::contentHash(payload);
+    if (options.embed == BatchOptions::Embed::HashAndPayload) {
+        metadata->payload = payload;
+    }
+    return metadata;
+}
+
+// State shared by the tasks of one large job between the codeword and raster stages.
+struct MaskJob {
+    int version;
+    qrcodegen::QrCode::Ecc ecc;
+    std::vector<std::uint8_t> dataCodewords;
+    Metadata metadata;
+    std::array<std::unique_ptr<qrcodegen::QrCode>, numMasks> candidates;
+    std::array<long, numMasks> penalties{};
+    std::atomic<int> remaining{numMasks};
+};
+
+void compressStage(std::size_t index, const std::vector<unsigned char>& image, unsigned side,
+                   const Metadata& metadata, const Sink& sink) {
+    sink(index, qrexport::encodeGreyscalePng(image, side, metadata.get()));
+}
+
+void rasterStage(Scheduler& scheduler, std::size_t index, const qrcodegen::QrCode& qr, const Metadata& metadata,
+                 const BatchOptions& options, const Sink& sink) {
+    const unsigned side = static_cast<unsigned>((qr.getSize() + options.border * 2) * options.scale);
+    auto image = std::make_shared<std::vector<unsigned char>>(qrexport::renderGreyscale(qr, options.scale, options.border));
+    scheduler.spawn([index, image, side, metadata, &sink] { compressStage(index, *image, side, metadata, sink); });
+}
+
+void maskStage(Scheduler& scheduler, std::size_t index, const std::shared_ptr<MaskJob>& job, int mask,
+               const BatchOptions& options, const Sink& sink) {
+    job->candidates[mask] = std::make_unique<qrcodegen::QrCode>(job->version, job->ecc, job->dataCodewords, mask);
+    job->penalties[mask] = job->candidates[mask]->getPenaltyScore();
+    if (job->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    // Last candidate in: keep the lowest penalty, the lowest mask number on ties, as the serial encoder does
+    int best = 0;
+    for (int i = 1; i < numMasks; ++i) {
+        if (job->penalties[i] < job->penalties[best]) {
+            best = i;
+        }
+    }
+    rasterStage(scheduler, index, *job->candidates[best], job->metadata, options, sink);
+}
+
+void codewordStage(Scheduler& scheduler, std::size_t index, const std::string& payload,
+                   const BatchOptions& options, const Sink& sink) {
+    auto job = std::make_shared<MaskJob>();
+    job->ecc = options.ecc;
+    const auto segs = qrcodegen::QrSegment::makeSegments(payload.c_str());
+    const int minVersion = qrcodegen::QrCode::getMinVersion(segs, job->ecc);
+    if (minVersion == -1) {
+        sink(index, {});
+        return;
+    }
+    job->dataCodewords = qrcodegen::QrCode::makeDataCodewords(segs, job->ecc, job->version, minVersion);
+
+    job->metadata = makeMetadata(payload, options);
+
+    if (job->version < options.fanOutVersion || options.mask != qrcodegen::QrCode::MaskStrategy::EXACT) {
+        const qrcodegen::QrCode qr(job->version, job->ecc, job->dataCodewords, -1, options.mask);
+        const unsigned side = static_cast<unsigned>((qr.getSize() + options.border * 2) * options.scale);
+        compressStage(index, qrexport::renderGreyscale(qr, options.scale, options.border), side, job->metadata, sink);
+        return;
+    }
+    for (int mask = 0; mask < numMasks; ++mask) {
+        scheduler.spawn([&scheduler, index, job, mask, &options, &sink] {
+            maskStage(scheduler, index, job, mask, options, sink);
+        });
+    }
+}
+
+using Seconds = std::chrono::duration<double>;
+
+struct EncodedItem {
+    std::size_t index;
+    std::optional<qrcodegen::QrCode> qr;    // Empty if the payload does not fit one code
+    Metadata metadata;
+};
+
+struct RasterItem {
+    std::size_t index;
+    std::vector<unsigned char> image;       // Empty if the payload does not fit one code
+    unsigned side;
+    Metadata metadata;
+};
+
+struct PngItem {
+    std::size_t index;
+    std::vector<unsigned char> png;
+};
+
+// Runs a stage body on `count` threads; the last one to finish closes the stage's output queue.
+// The first exception from any of them is kept in `error` and closes every queue through
+// `abort`, so that the rest of the pipeline unblocks and winds down.
+template <typename Body, typename Close, typename Abort>
+void startStage(std::vector<std::thread>& threads, unsigned count, Body body, Close closeOutput,
+                Abort abort, std::mutex& errorMutex, std::exception_ptr& error) {
+    auto running = std::make_shared<std::atomic<unsigned>>(count);
+    for (unsigned i = 0; i < count; ++i) {
+        threads.emplace_back([=, &errorMutex, &error] {
+            try {
+                body();
+            }
+            catch (...) {
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                abort();
+            }
+            if (running->fetch_sub(1) == 1) {
+                closeOutput();
+            }
+        });
+    }
+}
+
+// Adds the time since `start` to a stage total shared by its threads.
+void addSeconds(std::mutex& mutex, double& total, std::chrono::steady_clock::time_point start) {
+    const double seconds = Seconds(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(mutex);
+    total += seconds;
+}
+
+} // namespace
+
+Scheduler::Scheduler(unsigned numWorkers) {
+    if (numWorkers == 0) {
+        numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < numWorkers; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (unsigned i = 0; i < numWorkers; ++i) {
+        threads_.emplace_back([this, i] { run(i); });
+    }
+}
+
+Scheduler::~Scheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : threads_) {
+        t.join();
+    }
+}
+
+void Scheduler::spawn(Task task) {
+    const unsigned index = currentScheduler == this
+        ? currentWorker
+        : nextWorker_.fetch_add(1, std::memory_order_relaxed) % workers();
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+        workers_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++queued_;
+    }
+    wake_.notify_one();
+}
+
+void Scheduler::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_.load(std::memory_order_acquire) == 0; });
+    if (error_) {
+        std::exception_ptr error = std::exchange(error_, nullptr);
+        lock.unlock();
+        std::rethrow_exception(error);
+    }
+}
+
+std::vector<WorkerStats> Scheduler::stats() const {
+    std::vector<WorkerStats> result;
+    result.reserve(workers_.size());
+    for (const auto& worker : workers_) {
+        result.push_back(worker->stats);
+    }
+    return result;
+}
+
+bool Scheduler::take(unsigned index, Task& task, bool& stolen) {
+    {
+        Worker& own = *workers_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            stolen = false;
+            return true;
+        }
+    }
+    // Start at the next worker so that thieves do not all hit the same victim
+    for (unsigned offset = 1; offset < workers(); ++offset) {
+        Worker& victim = *workers_[(index + offset) % workers()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            stolen = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scheduler::run(unsigned index) {
+    currentScheduler = this;
+    currentWorker    = index;
+    WorkerStats& stats = workers_[index]->stats;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+            if (stopping_) {
+                return;
+            }
+        }
+
+        Task task;
+        bool stolen = false;
+        if (!take(index, task, stolen)) {
+            continue;  // Another worker got there first
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --queued_;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            task();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+        task = nullptr;  // Release captures before the job counts as finished
+        stats.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ++stats.tasks;
+        stats.stolen += stolen ? 1 : 0;
+
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.notify_all();
+        }
+    }
+}
+
+void encodeBatch(Scheduler& scheduler, const std::vector<std::string>& payloads,
+                 const BatchOptions& options, const Sink& sink) {
+    // Jobs are spawned cheapest first by estimated cost. Each worker runs its newest task
+    // first, so the costliest jobs start early and the cheap ones fill in at the end, as in
+    // longest-processing-time scheduling.
+    const qrcost::Estimator estimator{options.costModel};
+    std::vector<std::pair<double, std::size_t>> order;
+    order.reserve(payloads.size());
+    for (std::size_t i = 0; i < payloads.size(); ++i) {
+        order.emplace_back(estimator.estimate(payloads[i], options.ecc, options.scale, options.border).totalNs(), i);
+    }
+    std::sort(order.begin(), order.end());
+    for (const auto& [cost, i] : order) {
+        scheduler.spawn([&scheduler, i = i, &payloads, &options, &sink] {
+            codewordStage(scheduler, i, payloads[i], options, sink);
+        });
+    }
+    scheduler.wait();
+}
+
+PipelineStats streamBatch(const Source& source, const BatchOptions& options,
+                          const PipelineOptions& pipeline, const Sink& sink) {
+    using Clock = std::chrono::steady_clock;
+    const unsigned half = std::max(1u, std::thread::hardware_concurrency() / 2);
+    const unsigned encodeThreads   = pipeline.encodeThreads   != 0 ? pipeline.encodeThreads   : half;
+    const unsigned compressThreads = pipeline.compressThreads != 0 ? pipeline.compressThreads : half;
+
+    BoundedQueue<EncodedItem> encoded(pipeline.queueDepth);
+    BoundedQueue<RasterItem>  rastered(pipeline.queueDepth);
+    BoundedQueue<PngItem>     compressed(pipeline.queueDepth);
+    const auto abort = [&] {
+        encoded.close();
+        rastered.close();
+        compressed.close();
+    };
+
+    PipelineStats stats;
+    std::mutex statsMutex, sourceMutex, errorMutex;
+    std::exception_ptr error;
+    std::size_t nextIndex = 0;
+    std::vector<std::thread> threads;
+
+    startStage(threads, encodeThreads, [&] {
+        for (;;) {
+            const auto start = Clock::now();
+            EncodedItem item{0, std::nullopt, nullptr};
+            std::string payload;
+            {
+                std::lock_guard<std::mutex> lock(sourceMutex);
+                if (!source(payload)) {
+                    break;
+                }
+                item.index = nextIndex++;
+            }
+            auto result = qrcodegen::QrCode::tryEncodeSegments(
+                qrcodegen::QrSegment::makeSegments(payload.c_str()), options.ecc, qrcodegen::QrCode::MIN_VERSION,
+                qrcodegen::QrCode::MAX_VERSION, -1, true, options.mask);
+            if (result) {
+                item.qr.emplace(result.takeValue());
+            }
+            item.metadata = makeMetadata(payload, options);
+            addSeconds(statsMutex, stats.encodeSeconds, start);
+            if (!encoded.push(std::move(item))) {
+                break;
+            }
+        }
+    }, [&] { encoded.close(); }, abort, errorMutex, error);
+
+    startStage(threads, 1, [&] {
+        while (auto item = encoded.pop()) {
+            const auto start = Clock::now();
+            RasterItem raster{item->index, {}, 0, std::move(item->metadata)};
+            if (item->qr) {
+                raster.side  = static_cast<unsigned>((item->qr->getSize() + options.border * 2) * options.scale);
+                raster.image = qrexport::renderGreyscale(*item->qr, options.scale, options.border);
+            }
+            addSeconds(statsMutex, stats.rasterSeconds, start);
+            if (!rastered.push(std::move(raster))) {
+                break;
+            }
+        }
+    }, [&] { rastered.close(); }, abort, errorMutex, error);
+
+    startStage(threads, compressThreads, [&] {
+        while (auto item = rastered.pop()) {
+            const auto start = Clock::now();
+            PngItem png{item->index, {}};
+            if (!item->image.empty()) {
+                png.png = qrexport::encodeGreyscalePng(item->image, item->side, item->metadata.get());
+            }
+            addSeconds(statsMutex, stats.compressSeconds, start);
+            if (!compressed.push(std::move(png))) {
+                break;
+            }
+        }
+    }, [&] { compressed.close(); }, abort, errorMutex, error);
+
+    // The sink runs here, so a caller's file writes overlap the stages above
+    try {
+        while (auto item = compressed.pop()) {
+            const auto start = Clock::now();
+            sink(item->index, std::move(item->png));
+            stats.sinkSeconds += Seconds(Clock::now() - start).count();
+            ++stats.items;
+        }
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) {
+            error = std::current_exception();
+        }
+    }
+    abort();
+    for (auto& t : threads) {
+        t.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return stats;
+}
+
+} // namespace qrbatch
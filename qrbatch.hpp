@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "qrcodegen.hpp"
+#include "qrcost.hpp"
+
+// Batch encoding of many independent payloads on all cores. Payload sizes in a batch range from
+// version 1 codes, encoded in microseconds, to version 40 codes that cost far more in mask
+// scoring and deflate, so jobs run as tasks on a work-stealing scheduler instead of being split
+// into equal shares up front.
+namespace qrbatch {
+
+// What one worker thread did since the scheduler started.
+struct WorkerStats {
+    std::uint64_t tasks       = 0;    // Tasks run
+    std::uint64_t stolen      = 0;    // Of those, tasks taken from another worker's deque
+    double        busySeconds = 0;    // Time spent inside tasks
+};
+
+// A fixed set of worker threads, each owning a deque of tasks. A worker runs its newest task
+// first, so a job's follow-up stages run while its data is still in cache; a worker whose deque
+// is empty steals the oldest task of another, which is the biggest piece of work left there.
+// Tasks spawned from inside a task go to the current worker's deque, others are spread round
+// robin. Idle workers sleep until something is spawned.
+class Scheduler final {
+public:
+    using Task = std::function<void()>;
+
+    // numWorkers 0 uses one worker per hardware thread.
+    explicit Scheduler(unsigned numWorkers = 0);
+    ~Scheduler();
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    void spawn(Task task);
+
+    // Blocks until every task, including those spawned by tasks, has finished. If any task
+    // threw, rethrows the first exception once the others are done.
+    void wait();
+
+    [[nodiscard]]
+    unsigned workers() const noexcept { return static_cast<unsigned>(workers_.size()); }
+
+    // Per-worker counters; only consistent while no tasks are running, e.g. after wait().
+    [[nodiscard]]
+    std::vector<WorkerStats> stats() const;
+
+private:
+    struct Worker {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+        WorkerStats      stats;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread>             threads_;
+
+    std::mutex              mutex_;          // Guards queued_, stopping_ and error_ for the waits below
+    std::condition_variable wake_;           // Signalled when a task is queued or on shutdown
+    std::condition_variable done_;           // Signalled when pending_ drops to zero
+    std::size_t             queued_  = 0;    // Tasks sitting in deques
+    bool                    stopping_ = false;
+    std::exception_ptr      error_;
+
+    std::atomic<std::size_t> pending_{0};    // Tasks queued or running
+    std::atomic<unsigned>    nextWorker_{0};
+
+    void run(unsigned index);
+
+    [[nodiscard]]
+    bool take(unsigned index, Task& task, bool& stolen);
+};
+
+struct BatchOptions {
+    qrcodegen::QrCode::Ecc ecc = qrcodegen::QrCode::Ecc::MEDIUM;
+    int scale  = 4;
+    int border = 4;
+    // How the mask is chosen; FAST and FIXED trade a slightly higher penalty for less scoring
+    qrcodegen::QrCode::MaskStrategy mask = qrcodegen::QrCode::MaskStrategy::EXACT;
+    // With the EXACT strategy, codes of this version or larger score their eight mask candidates
+    // as separate tasks; smaller ones, and all codes with the other strategies, are encoded,
+    // rendered and compressed as a single task.
+    int fanOutVersion = 15;
+    // What each PNG records about its payload in text chunks (see qrexport::PngMetadata)
+    enum class Embed { Nothing, Hash, HashAndPayload };
+    Embed embed = Embed::Nothing;
+    // The model encodeBatch estimates job costs with to order them, e.g. one that `qrtool
+    // bench-cost` calibrated on this machine
+    qrcost::CostModel costModel;
+};
+
+// Receives each finished image, in no particular order: on a worker thread from encodeBatch, on
+// the calling thread from streamBatch. The PNG is empty if the payload does not fit one code or
+// compression failed.
+using Sink = std::function<void(std::size_t index, std::vector<unsigned char>&& png)>;
+
+// Encodes every payload as one code and renders it as a 1-bit greyscale PNG, waiting for all of
+// them. Large codes go through separate stages, each spawned by the one before: segmentation
+// into data codewords, then the mask candidates in parallel, then rasterisation, then
+// compression. The mask chosen is the one QrCode::encodeSegments would choose with options.mask,
+// so the output does not depend on the number of workers. Exceptions thrown by the sink are rethrown.
+void encodeBatch(Scheduler& scheduler, const std::vector<std::string>& payloads,
+                 const BatchOptions& options, const Sink& sink);
+
+// A fixed-capacity FIFO between two pipeline stages. push blocks while the queue is full, which
+// bounds the memory held by a pipeline whose later stages are slower than its earlier ones;
+// pop blocks while it is empty. After close, push refuses new items and pop drains the rest.
+template <typename T>
+class BoundedQueue final {
+public:
+    explicit BoundedQueue(std::size_t capacity)
+        : capacity_{std::max<std::size_t>(capacity, 1)} {}
+
+    // Returns false, dropping the item, if the queue has been closed.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        lock.unlock();
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    // Returns nothing once the queue is closed and empty.
+    [[nodiscard]]
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        if (items_.empty()) {
+            return std::nullopt;
+        }
+        std::optional<T> item{std::move(items_.front())};
+        items_.pop_front();
+        lock.unlock();
+        notFull_.notify_one();
+        return item;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+
+private:
+    std::size_t             capacity_;
+    std::deque<T>           items_;
+    std::mutex              mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+    bool                    closed_ = false;
+};
+
+// Produces the next payload of a stream; returns false at the end of the input.
+using Source = std::function<bool(std::string& payload)>;
+
+struct PipelineOptions {
+    unsigned    encodeThreads   = 0;    // 0 uses half the hardware threads, at least one
+    unsigned    compressThreads = 0;    // Likewise
+    std::size_t queueDepth      = 16;   // Items each queue between two stages can hold
+};
+
+// Time each stage spent working, summed over its threads, excluding time blocked on a queue.
+struct PipelineStats {
+    std::size_t items           = 0;
+    double      encodeSeconds   = 0;    // Reading the source, segmentation, ECC and masking
+    double      rasterSeconds   = 0;
+    double      compressSeconds = 0;
+    double      sinkSeconds     = 0;
+};
+
+// Streaming counterpart of encodeBatch for input of unbounded length. Each stage runs on its
+// own threads, connected by bounded queues: encode (which pulls from the source), raster,
+// compress, and the sink on the calling thread. Sink I/O thus overlaps the encoding of later
+// payloads, and when the sink falls behind, the full queues stall the earlier stages, so
+// memory stays bounded by the queue depths whatever the input length. Payloads are numbered in
+// source order, but reach the sink in no particular order. If the source, the sink or a stage
+// throws, the queues are closed, the threads are joined and the first exception is rethrown.
+PipelineStats streamBatch(const Source& source, const BatchOptions& options,
+                          const PipelineOptions& pipeline, const Sink& sink);
+
+} // namespace qrbatch
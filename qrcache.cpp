@@ -0,0 +1,131 @@
+#include "qrcache.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace qrcache {
+
+void appendRecord(std::vector<unsigned char>& out, const qrcodegen::QrCode& qr) {
+    const std::size_t start = out.size();
+    out.resize(start + recordSize(qr.getVersion()));
+    unsigned char* record = out.data() + start;
+    record[0] = 'Q';
+    record[1] = static_cast<unsigned char>(qr.getVersion());
+    record[2] = static_cast<unsigned char>(qr.getErrorCorrectionLevel());
+    record[3] = static_cast<unsigned char>(qr.getMask());
+
+    const int size = qr.getSize();
+    std::size_t i = 0;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x, ++i) {
+            if (qr.getModule(x, y)) {
+                record[headerSize + (i >> 3)] |= static_cast<unsigned char>(0x80 >> (i & 7));
+            }
+        }
+    }
+}
+
+CodeView::CodeView(const unsigned char* data, std::size_t available)
+    : data_{data}
+    , size_{0} {
+    if (available < headerSize || data[0] != 'Q'
+            || data[1] < qrcodegen::QrCode::MIN_VERSION || data[1] > qrcodegen::QrCode::MAX_VERSION
+            || data[2] > 3 || data[3] > 7) {
+        throw std::invalid_argument("Not a code record");
+    }
+    if (available < recordSize(data[1])) {
+        throw std::invalid_argument("Truncated code record");
+    }
+    size_ = data[1] * 4 + 17;
+}
+
+std::vector<CodeView> parseRecords(const unsigned char* data, std::size_t size) {
+    std::vector<CodeView> views;
+    for (std::size_t pos = 0; pos < size; ) {
+        views.emplace_back(data + pos, size - pos);
+        pos += views.back().byteSize();
+    }
+    return views;
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    file_ = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER length;
+    if (file_ == INVALID_HANDLE_VALUE || !::GetFileSizeEx(file_, &length)) {
+        if (file_ != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(file_);
+        }
+        file_ = nullptr;
+        throw std::runtime_error("Cannot open " + path.string());
+    }
+    size_ = static_cast<std::size_t>(length.QuadPart);
+    if (size_ == 0) {
+        return;  // Empty files cannot be mapped
+    }
+    mapping_ = ::CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    data_ = mapping_ ? static_cast<const unsigned char*>(::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (!data_) {
+        if (mapping_) {
+            ::CloseHandle(mapping_);
+        }
+        ::CloseHandle(file_);
+        throw std::runtime_error("Cannot map " + path.string());
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        ::UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+        ::CloseHandle(mapping_);
+    }
+    if (file_) {
+        ::CloseHandle(file_);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || ::fstat(fd, &info) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error("Cannot open " + path.string());
+    }
+    size_ = static_cast<std::size_t>(info.st_size);
+    if (size_ != 0) {
+        void* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Cannot map " + path.string());
+        }
+        data_ = static_cast<const unsigned char*>(mapped);
+    }
+    ::close(fd);  // The mapping stays valid without the descriptor
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        ::munmap(const_cast<unsigned char*>(data_), size_);
+    }
+}
+
+#endif
+
+} // namespace qrcache
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "qrcodegen.hpp"
+
+// Compact serialised form of finished codes, so that encode results can be cached in files,
+// handed between processes and rendered later without encoding again.
+//
+// A record is a 4-byte header, 'Q', version, error correction level (0 to 3, as Ecc) and mask,
+// followed by the size * size modules in row-major order, eight to a byte, most significant
+// bit first, dark = 1, with only the last byte padded. A version 40 record is 3921 bytes.
+// A cache file is records back to back; each record's length follows from its version.
+namespace qrcache {
+
+constexpr std::size_t headerSize = 4;
+
+// Bytes in the record of a code of the given version (1 to 40).
+[[nodiscard]]
+constexpr std::size_t recordSize(int version) noexcept {
+    const std::size_t size = static_cast<std::size_t>(version) * 4 + 17;
+    return headerSize + (size * size + 7) / 8;
+}
+
+// Appends the record of a code to out.
+void appendRecord(std::vector<unsigned char>& out, const qrcodegen::QrCode& qr);
+
+// A read-only view of one record in memory the caller keeps alive, such as a mapped file.
+// It answers the same queries as QrCode, so the renderers take either.
+class CodeView final {
+public:
+    // Checks the header and that the whole record lies within [data, data + available).
+    // Throws std::invalid_argument otherwise.
+    CodeView(const unsigned char* data, std::size_t available);
+
+    [[nodiscard]] int getVersion() const noexcept { return data_[1]; }
+    [[nodiscard]] int getSize() const noexcept { return size_; }
+    [[nodiscard]] qrcodegen::QrCode::Ecc getErrorCorrectionLevel() const noexcept {
+        return static_cast<qrcodegen::QrCode::Ecc>(data_[2]);
+    }
+    [[nodiscard]] int getMask() const noexcept { return data_[3]; }
+
+    // Like QrCode::getModule: false (light) outside the symbol.
+    [[nodiscard]]
+    bool getModule(int x, int y) const noexcept {
+        if (x < 0 || x >= size_ || y < 0 || y >= size_) {
+            return false;
+        }
+        const std::size_t i = static_cast<std::size_t>(y) * static_cast<std::size_t>(size_) + static_cast<std::size_t>(x);
+        return ((data_[headerSize + (i >> 3)] >> (7 - (i & 7))) & 1) != 0;
+    }
+
+    // Length of the record, for stepping to the next one.
+    [[nodiscard]]
+    std::size_t byteSize() const noexcept { return recordSize(getVersion()); }
+
+private:
+    const unsigned char* data_;
+    int size_;
+};
+
+// Splits a cache file image into views of its records. Throws std::invalid_argument if a record
+// is malformed or truncated.
+[[nodiscard]]
+std::vector<CodeView> parseRecords(const unsigned char* data, std::size_t size);
+
+// A whole file mapped read-only into memory, for views that never copy the records.
+class MappedFile final {
+public:
+    // Throws std::runtime_error if the file cannot be opened or mapped.
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    [[nodiscard]] const unsigned char* data() const noexcept { return data_; }
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+private:
+    const unsigned char* data_ = nullptr;
+    std::size_t          size_ = 0;
+#ifdef _WIN32
+    void* file_    = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+
+} // namespace qrcache
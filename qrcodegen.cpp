@@ -28,7 +28,18 @@
 #include <cstdlib>
 #include <cstring>
 #include <sstream>
+#include <string>
 #include <utility>
+#if defined(__SSE2__)
+	#include <immintrin.h>
+#endif
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+#else
+	#include <chrono>
+#endif
 #include "qrcodegen.hpp"
 
 using std::int8_t;
@@ -70,54 +81,90 @@ QrSegment QrSegment::makeBytes(const vector<uint8_t> &data) {
 	if (data.size() > static_cast<unsigned int>(INT_MAX))
 		throw std::length_error("Data too long");
 	BitBuffer bb;
-	for (uint8_t b : data)
-		bb.appendBits(b, 8);
+	bb.resize(data.size() * 8);
+	size_t i = 0;
+	for (; i + 3 <= data.size(); i += 3)  // Three bytes per call
+		bb.orBits(i * 8, static_cast<uint32_t>(data[i]) << 16 | static_cast<uint32_t>(data[i + 1]) << 8 | data[i + 2], 24);
+	for (; i < data.size(); i++)
+		bb.orBits(i * 8, data[i], 8);
 	return QrSegment(Mode::BYTE, static_cast<int>(data.size()), std::move(bb));
 }
 
 
 QrSegment QrSegment::makeNumeric(const char *digits) {
+	size_t len = std::strlen(digits);
 	BitBuffer bb;
+	bb.resize(len / 3 * 10 + (len % 3 == 0 ? 0 : len % 3 * 3 + 1));
+	size_t pos = 0;
+	uint32_t word = 0;  // Up to three packed 10-bit groups
+	int wordBits = 0;
 	int accumData = 0;
 	int accumCount = 0;
 	int charCount = 0;
 	for (; *digits != '\0'; digits++, charCount++) {
-		char c = *digits;
-		if (c < '0' || c > '9')
+		int cls = CHARACTER_CLASSES[static_cast<uint8_t>(*digits)];
+		if ((cls & CLASS_NUMERIC) == 0)
 			throw std::domain_error("String contains non-numeric characters");
-		accumData = accumData * 10 + (c - '0');
+		accumData = accumData * 10 + (cls & 0x3F);  // A digit's charset index is its value
 		accumCount++;
 		if (accumCount == 3) {
-			bb.appendBits(static_cast<uint32_t>(accumData), 10);
+			word = word << 10 | static_cast<uint32_t>(accumData);
+			wordBits += 10;
+			if (wordBits == 30) {
+				bb.orBits(pos, word, wordBits);
+				pos += static_cast<size_t>(wordBits);
+				word = 0;
+				wordBits = 0;
+			}
 			accumData = 0;
 			accumCount = 0;
 		}
 	}
+	if (wordBits > 0) {
+		bb.orBits(pos, word, wordBits);
+		pos += static_cast<size_t>(wordBits);
+	}
 	if (accumCount > 0)  // 1 or 2 digits remaining
-		bb.appendBits(static_cast<uint32_t>(accumData), accumCount * 3 + 1);
+		bb.orBits(pos, static_cast<uint32_t>(accumData), accumCount * 3 + 1);
 	return QrSegment(Mode::NUMERIC, charCount, std::move(bb));
 }
 
 
 QrSegment QrSegment::makeAlphanumeric(const char *text) {
+	size_t len = std::strlen(text);
 	BitBuffer bb;
+	bb.resize(len / 2 * 11 + len % 2 * 6);
+	size_t pos = 0;
+	uint32_t word = 0;  // Up to two packed 11-bit pairs
+	int wordBits = 0;
 	int accumData = 0;
 	int accumCount = 0;
 	int charCount = 0;
 	for (; *text != '\0'; text++, charCount++) {
-		const char *temp = std::strchr(ALPHANUMERIC_CHARSET, *text);
-		if (temp == nullptr)
+		int cls = CHARACTER_CLASSES[static_cast<uint8_t>(*text)];
+		if ((cls & CLASS_ALPHANUMERIC) == 0)
 			throw std::domain_error("String contains unencodable characters in alphanumeric mode");
-		accumData = accumData * 45 + static_cast<int>(temp - ALPHANUMERIC_CHARSET);
+		accumData = accumData * 45 + (cls & 0x3F);
 		accumCount++;
 		if (accumCount == 2) {
-			bb.appendBits(static_cast<uint32_t>(accumData), 11);
+			word = word << 11 | static_cast<uint32_t>(accumData);
+			wordBits += 11;
+			if (wordBits == 22) {
+				bb.orBits(pos, word, wordBits);
+				pos += static_cast<size_t>(wordBits);
+				word = 0;
+				wordBits = 0;
+			}
 			accumData = 0;
 			accumCount = 0;
 		}
 	}
+	if (wordBits > 0) {
+		bb.orBits(pos, word, wordBits);
+		pos += static_cast<size_t>(wordBits);
+	}
 	if (accumCount > 0)  // 1 character remaining
-		bb.appendBits(static_cast<uint32_t>(accumData), 6);
+		bb.orBits(pos, static_cast<uint32_t>(accumData), 6);
 	return QrSegment(Mode::ALPHANUMERIC, charCount, std::move(bb));
 }
 
@@ -125,16 +172,18 @@ QrSegment QrSegment::makeAlphanumeric(const char *text) {
 vector<QrSegment> QrSegment::makeSegments(const char *text) {
 	// Select the most efficient segment encoding automatically
 	vector<QrSegment> result;
-	if (*text == '\0');  // Leave result empty
-	else if (isNumeric(text))
-		result.push_back(makeNumeric(text));
-	else if (isAlphanumeric(text))
-		result.push_back(makeAlphanumeric(text));
+	size_t len = std::strlen(text);
+	if (len == 0);  // Leave result empty
 	else {
-		vector<uint8_t> bytes;
-		for (; *text != '\0'; text++)
-			bytes.push_back(static_cast<uint8_t>(*text));
-		result.push_back(makeBytes(bytes));
+		int classes = classifyText(text, len);  // One pass decides the mode
+		if ((classes & CLASS_NUMERIC) != 0)
+			result.push_back(makeNumeric(text));
+		else if ((classes & CLASS_ALPHANUMERIC) != 0)
+			result.push_back(makeAlphanumeric(text));
+		else {
+			const uint8_t *bytes = reinterpret_cast<const uint8_t*>(text);
+			result.push_back(makeBytes(vector<uint8_t>(bytes, bytes + len)));
+		}
 	}
 	return result;
 }
@@ -194,21 +243,59 @@ int QrSegment::getTotalBits(const vector<QrSegment> &segs, int version) {
 
 
 bool QrSegment::isNumeric(const char *text) {
-	for (; *text != '\0'; text++) {
-		char c = *text;
-		if (c < '0' || c > '9')
-			return false;
-	}
-	return true;
+	return (classifyText(text, std::strlen(text)) & CLASS_NUMERIC) != 0;
 }
 
 
 bool QrSegment::isAlphanumeric(const char *text) {
-	for (; *text != '\0'; text++) {
-		if (std::strchr(ALPHANUMERIC_CHARSET, *text) == nullptr)
-			return false;
+	return (classifyText(text, std::strlen(text)) & CLASS_ALPHANUMERIC) != 0;
+}
+
+
+int QrSegment::classifyText(const char *text, size_t len) {
+	int result = CLASS_NUMERIC | CLASS_ALPHANUMERIC;
+	size_t i = 0;
+	
+#if defined(__AVX2__)
+	// Unsigned range test: (v - lo) <= n - 1
+	#define QRCODEGEN_IN_RANGE_256(v, lo, n)  _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8((v), _mm256_set1_epi8(lo)), _mm256_set1_epi8((n) - 1)), _mm256_setzero_si256())
+	for (; i + 32 <= len && result != 0; i += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+		__m256i digit = QRCODEGEN_IN_RANGE_256(v, '0', 10);
+		__m256i alnum = _mm256_or_si256(
+			_mm256_or_si256(QRCODEGEN_IN_RANGE_256(v, '0', 11), QRCODEGEN_IN_RANGE_256(v, 'A', 26)),  // 0-9 : A-Z
+			_mm256_or_si256(
+				_mm256_andnot_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')), QRCODEGEN_IN_RANGE_256(v, '*', 6)),  // *+-./
+				_mm256_or_si256(QRCODEGEN_IN_RANGE_256(v, '$', 2), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')))));  // $% space
+		if (_mm256_movemask_epi8(digit) != -1)
+			result &= ~CLASS_NUMERIC;
+		if (_mm256_movemask_epi8(alnum) != -1)
+			result &= ~CLASS_ALPHANUMERIC;
 	}
-	return true;
+	#undef QRCODEGEN_IN_RANGE_256
+#endif
+	
+#if defined(__SSE2__)
+	#define QRCODEGEN_IN_RANGE_128(v, lo, n)  _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8((v), _mm_set1_epi8(lo)), _mm_set1_epi8((n) - 1)), _mm_setzero_si128())
+	for (; i + 16 <= len && result != 0; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+		__m128i digit = QRCODEGEN_IN_RANGE_128(v, '0', 10);
+		__m128i alnum = _mm_or_si128(
+			_mm_or_si128(QRCODEGEN_IN_RANGE_128(v, '0', 11), QRCODEGEN_IN_RANGE_128(v, 'A', 26)),
+			_mm_or_si128(
+				_mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(',')), QRCODEGEN_IN_RANGE_128(v, '*', 6)),
+				_mm_or_si128(QRCODEGEN_IN_RANGE_128(v, '$', 2), _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')))));
+		if (_mm_movemask_epi8(digit) != 0xFFFF)
+			result &= ~CLASS_NUMERIC;
+		if (_mm_movemask_epi8(alnum) != 0xFFFF)
+			result &= ~CLASS_ALPHANUMERIC;
+	}
+	#undef QRCODEGEN_IN_RANGE_128
+#endif
+	
+	for (; i < len && result != 0; i++)
+		result &= CHARACTER_CLASSES[static_cast<uint8_t>(text[i])];
+	return result & (CLASS_NUMERIC | CLASS_ALPHANUMERIC);
 }
 
 
@@ -227,7 +314,16 @@ const std::vector<bool> &QrSegment::getData() const {
 }
 
 
-const char *QrSegment::ALPHANUMERIC_CHARSET = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
+
+// Reads the counter that EncodeDiagnostics cycle counts are measured in.
+static long long readCycleCounter() {
+	#if (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))) || defined(__x86_64__) || defined(__i386__)
+		return static_cast<long long>(__rdtsc());
+	#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	#endif
+}
 
 
 
@@ -257,31 +353,45 @@ QrCode QrCode::encodeBinary(const vector<uint8_t> &data, Ecc ecl) {
 
 
 QrCode QrCode::encodeSegments(const vector<QrSegment> &segs, Ecc ecl,
-		int minVersion, int maxVersion, int mask, bool boostEcl) {
-	if (!(MIN_VERSION <= minVersion && minVersion <= maxVersion && maxVersion <= MAX_VERSION) || mask < -1 || mask > 7)
+		int minVersion, int maxVersion, int mask, bool boostEcl, MaskStrategy strategy,
+		EncodeDiagnostics *diagnostics) {
+	if (mask < -1 || mask > 7)
 		throw std::invalid_argument("Invalid value");
+	int version;
+	const vector<uint8_t> dataCodewords = makeDataCodewords(segs, ecl, version, minVersion, maxVersion, boostEcl, diagnostics);
+	
+	// Create the QR Code object
+	return QrCode(version, ecl, dataCodewords, mask, strategy, diagnostics);
+}
+
+
+// Formats the message of the data_too_long thrown when segments needing dataUsedBits
+// (-1 if a segment is too long) miss a capacity of dataCapacityBits.
+static std::string tooLongMessage(int dataUsedBits, int dataCapacityBits) {
+	if (dataUsedBits == -1)
+		return "Segment too long";
+	std::ostringstream sb;
+	sb << "Data length = " << dataUsedBits << " bits, ";
+	sb << "Max capacity = " << dataCapacityBits << " bits";
+	return sb.str();
+}
+
+
+vector<uint8_t> QrCode::makeDataCodewords(const vector<QrSegment> &segs, Ecc &ecl, int &version,
+		int minVersion, int maxVersion, bool boostEcl, EncodeDiagnostics *diagnostics) {
+	long long startCycles = diagnostics != nullptr ? readCycleCounter() : 0;
 	
 	// Find the minimal version number to use
-	int version, dataUsedBits;
-	for (version = minVersion; ; version++) {
-		int dataCapacityBits = getNumDataCodewords(version, ecl) * 8;  // Number of data bits available
-		dataUsedBits = QrSegment::getTotalBits(segs, version);
-		if (dataUsedBits != -1 && dataUsedBits <= dataCapacityBits)
-			break;  // This version number is found to be suitable
-		if (version >= maxVersion) {  // All versions in the range could not fit the given data
-			std::ostringstream sb;
-			if (dataUsedBits == -1)
-				sb << "Segment too long";
-			else {
-				sb << "Data length = " << dataUsedBits << " bits, ";
-				sb << "Max capacity = " << dataCapacityBits << " bits";
-			}
-			throw data_too_long(sb.str());
-		}
+	version = getMinVersion(segs, ecl, minVersion, maxVersion);
+	if (version == -1) {  // All versions in the range could not fit the given data
+		throw data_too_long(tooLongMessage(QrSegment::getTotalBits(segs, maxVersion),
+			getNumDataCodewords(maxVersion, ecl) * 8));
 	}
+	int dataUsedBits = QrSegment::getTotalBits(segs, version);
 	assert(dataUsedBits != -1);
 	
 	// Increase the error correction level while the data still fits in the current version number
+	Ecc requestedEcl = ecl;
 	for (Ecc newEcl : {Ecc::MEDIUM, Ecc::QUARTILE, Ecc::HIGH}) {  // From low to high
 		if (boostEcl && dataUsedBits <= getNumDataCodewords(version, newEcl) * 8)
 			ecl = newEcl;
@@ -312,12 +422,88 @@ QrCode QrCode::encodeSegments(const vector<QrSegment> &segs, Ecc ecl,
 	for (size_t i = 0; i < bb.size(); i++)
 		dataCodewords.at(i >> 3) |= (bb.at(i) ? 1 : 0) << (7 - (i & 7));
 	
-	// Create the QR Code object
-	return QrCode(version, ecl, dataCodewords, mask);
+	if (diagnostics != nullptr) {
+		diagnostics->segments.clear();
+		for (const QrSegment &seg : segs) {
+			diagnostics->segments.push_back(EncodeDiagnostics::Segment{
+				seg.getMode().getModeBits(), seg.getNumChars(), static_cast<int>(seg.getData().size())});
+		}
+		diagnostics->dataUsedBits = dataUsedBits;
+		diagnostics->dataCapacityBits = static_cast<int>(dataCapacityBits);
+		diagnostics->requestedEcl = requestedEcl;
+		diagnostics->chosenEcl = ecl;
+		diagnostics->segmentCycles = readCycleCounter() - startCycles;
+	}
+	return dataCodewords;
 }
 
 
-QrCode::QrCode(int ver, Ecc ecl, const vector<uint8_t> &dataCodewords, int msk) :
+EncodeResult QrCode::tryEncodeSegments(const vector<QrSegment> &segs, Ecc ecl,
+		int minVersion, int maxVersion, int mask, bool boostEcl, MaskStrategy strategy,
+		EncodeDiagnostics *diagnostics) {
+	if (mask < -1 || mask > 7)
+		throw std::invalid_argument("Invalid value");
+	if (getMinVersion(segs, ecl, minVersion, maxVersion) == -1) {
+		return EncodeResult(QrSegment::getTotalBits(segs, maxVersion),
+			getNumDataCodewords(maxVersion, ecl) * 8);
+	}
+	int version;
+	const vector<uint8_t> dataCodewords = makeDataCodewords(segs, ecl, version, minVersion, maxVersion, boostEcl, diagnostics);
+	return EncodeResult(QrCode(version, ecl, dataCodewords, mask, strategy, diagnostics));
+}
+
+
+int QrCode::getMinVersion(const vector<QrSegment> &segs, Ecc ecl, int minVersion, int maxVersion) {
+	if (!(MIN_VERSION <= minVersion && minVersion <= maxVersion && maxVersion <= MAX_VERSION))
+		throw std::invalid_argument("Invalid value");
+	for (int version = minVersion; version <= maxVersion; version++) {
+		int dataUsedBits = QrSegment::getTotalBits(segs, version);
+		if (dataUsedBits != -1 && dataUsedBits <= getNumDataCodewords(version, ecl) * 8)
+			return version;
+	}
+	return -1;
+}
+
+
+int QrCode::getMaxPayload(int ver, Ecc ecl, const QrSegment::Mode &mode) {
+	if (ver < MIN_VERSION || ver > MAX_VERSION)
+		throw std::invalid_argument("Version number out of range");
+	const QrSegment::Mode *const modes[] = {
+		&QrSegment::Mode::NUMERIC, &QrSegment::Mode::ALPHANUMERIC, &QrSegment::Mode::BYTE, &QrSegment::Mode::KANJI};
+	int modeIndex = 0;
+	while (modeIndex < 4 && modes[modeIndex]->getModeBits() != mode.getModeBits())
+		modeIndex++;
+	if (modeIndex == 4)
+		throw std::invalid_argument("Mode has no character capacity");
+	
+	// Characters per mode that fit the bits left after the segment header, capped by what the
+	// character count field can express
+	static const std::array<std::array<std::array<int,4>,4>,MAX_VERSION + 1> table = [&modes] {
+		std::array<std::array<std::array<int,4>,4>,MAX_VERSION + 1> result{};
+		for (int v = MIN_VERSION; v <= MAX_VERSION; v++) {
+			for (int e = 0; e < 4; e++) {
+				for (int m = 0; m < 4; m++) {
+					int ccbits = modes[m]->numCharCountBits(v);
+					int bits = getNumDataCodewords(v, static_cast<Ecc>(e)) * 8 - 4 - ccbits;
+					int chars;
+					switch (m) {
+						case 0:  chars = bits / 10 * 3 + (bits % 10 >= 7 ? 2 : bits % 10 >= 4 ? 1 : 0);  break;
+						case 1:  chars = bits / 11 * 2 + (bits % 11 >= 6 ? 1 : 0);  break;
+						case 2:  chars = bits / 8;  break;
+						default:  chars = bits / 13;  break;
+					}
+					result[v][e][m] = std::min(chars, (1 << ccbits) - 1);
+				}
+			}
+		}
+		return result;
+	}();
+	return table[ver][static_cast<int>(ecl)][modeIndex];
+}
+
+
+QrCode::QrCode(int ver, Ecc ecl, const vector<uint8_t> &dataCodewords, int msk, MaskStrategy strategy,
+		EncodeDiagnostics *diagnostics) :
 		// Initialize fields and check arguments
 		version(ver),
 		errorCorrectionLevel(ecl) {
@@ -331,28 +517,65 @@ QrCode::QrCode(int ver, Ecc ecl, const vector<uint8_t> &dataCodewords, int msk)
 	isFunction = vector<vector<bool> >(sz, vector<bool>(sz));
 	
 	// Compute ECC, draw modules
+	long long cycles[4] = {};  // Only read with diagnostics
+	if (diagnostics != nullptr)
+		cycles[0] = readCycleCounter();
 	drawFunctionPatterns();
+	if (diagnostics != nullptr)
+		cycles[1] = readCycleCounter();
 	const vector<uint8_t> allCodewords = addEccAndInterleave(dataCodewords);
+	if (diagnostics != nullptr)
+		cycles[2] = readCycleCounter();
 	drawCodewords(allCodewords);
+	if (diagnostics != nullptr) {
+		cycles[3] = readCycleCounter();
+		diagnostics->eccCycles = cycles[2] - cycles[1];
+		diagnostics->placementCycles = (cycles[1] - cycles[0]) + (cycles[3] - cycles[2]);
+		diagnostics->maskPenalties.fill(-1);
+	}
 	
 	// Do masking
-	if (msk == -1) {  // Automatically choose best mask
-		long minPenalty = LONG_MAX;
+	if (msk == -1 && strategy == MaskStrategy::FIXED)
+		msk = FIXED_MASKS[ver];
+	else if (msk == -1) {  // Automatically choose best mask
+		std::array<long,8> penalties;
 		for (int i = 0; i < 8; i++) {
 			applyMask(i);
 			drawFormatBits(i);
-			long penalty = getPenaltyScore();
+			penalties.at(static_cast<size_t>(i)) = strategy == MaskStrategy::EXACT ? getPenaltyScore() : getApproximatePenaltyScore();
+			applyMask(i);  // Undoes the mask due to XOR
+		}
+		long minPenalty = LONG_MAX;
+		int runnerUp = -1;
+		for (int i = 0; i < 8; i++) {
+			long penalty = penalties.at(static_cast<size_t>(i));
 			if (penalty < minPenalty) {
+				runnerUp = msk;
 				msk = i;
 				minPenalty = penalty;
+			} else if (runnerUp == -1 || penalty < penalties.at(static_cast<size_t>(runnerUp)))
+				runnerUp = i;
+		}
+		if (strategy == MaskStrategy::FAST) {  // Settle between the two best candidates exactly
+			long exactPenalty[2];
+			const int candidates[2] = {std::min(msk, runnerUp), std::max(msk, runnerUp)};
+			for (int i = 0; i < 2; i++) {
+				applyMask(candidates[i]);
+				drawFormatBits(candidates[i]);
+				exactPenalty[i] = getPenaltyScore();
+				applyMask(candidates[i]);
 			}
-			applyMask(i);  // Undoes the mask due to XOR
+			msk = candidates[exactPenalty[1] < exactPenalty[0] ? 1 : 0];
 		}
+		if (diagnostics != nullptr)
+			diagnostics->maskPenalties = penalties;
 	}
 	assert(0 <= msk && msk <= 7);
 	mask = msk;
 	applyMask(msk);  // Apply the final choice of mask
 	drawFormatBits(msk);  // Overwrite old format bits
+	if (diagnostics != nullptr)
+		diagnostics->maskCycles = readCycleCounter() - cycles[3];
 	
 	isFunction.clear();
 	isFunction.shrink_to_fit();
@@ -500,35 +723,54 @@ vector<uint8_t> QrCode::addEccAndInterleave(const vector<uint8_t> &data) const {
 		throw std::invalid_argument("Invalid argument");
 	
 	// Calculate parameter numbers
-	int numBlocks = NUM_ERROR_CORRECTION_BLOCKS[static_cast<int>(errorCorrectionLevel)][version];
-	int blockEccLen = ECC_CODEWORDS_PER_BLOCK  [static_cast<int>(errorCorrectionLevel)][version];
-	int rawCodewords = getNumRawDataModules(version) / 8;
-	int numShortBlocks = numBlocks - rawCodewords % numBlocks;
-	int shortBlockLen = rawCodewords / numBlocks;
-	
-	// Split data into blocks and append ECC to each block
-	vector<vector<uint8_t> > blocks;
-	const vector<uint8_t> rsDiv = reedSolomonComputeDivisor(blockEccLen);
-	for (int i = 0, k = 0; i < numBlocks; i++) {
-		vector<uint8_t> dat(data.cbegin() + k, data.cbegin() + (k + shortBlockLen - blockEccLen + (i < numShortBlocks ? 0 : 1)));
-		k += static_cast<int>(dat.size());
-		const vector<uint8_t> ecc = reedSolomonComputeRemainder(dat, rsDiv);
-		if (i < numShortBlocks)
-			dat.push_back(0);
-		dat.insert(dat.end(), ecc.cbegin(), ecc.cend());
-		blocks.push_back(std::move(dat));
-	}
-	
-	// Interleave (not concatenate) the bytes from every block into a single sequence
-	vector<uint8_t> result;
-	for (size_t i = 0; i < blocks.at(0).size(); i++) {
-		for (size_t j = 0; j < blocks.size(); j++) {
-			// Skip the padding byte in short blocks
-			if (i != static_cast<unsigned int>(shortBlockLen - blockEccLen) || j >= static_cast<unsigned int>(numShortBlocks))
-				result.push_back(blocks.at(j).at(i));
+	size_t numBlocks = static_cast<size_t>(NUM_ERROR_CORRECTION_BLOCKS[static_cast<int>(errorCorrectionLevel)][version]);
+	size_t blockEccLen = static_cast<size_t>(ECC_CODEWORDS_PER_BLOCK  [static_cast<int>(errorCorrectionLevel)][version]);
+	size_t rawCodewords = static_cast<size_t>(getNumRawDataModules(version) / 8);
+	size_t numShortBlocks = numBlocks - rawCodewords % numBlocks;
+	size_t shortDataLen = rawCodewords / numBlocks - blockEccLen;
+	
+	// Interleave (not concatenate) the data bytes: column i of the
+	// result gathers byte i of every block, and only long blocks have
+	// a byte in the last column. Nothing is copied out per block.
+	vector<uint8_t> result(rawCodewords);
+	vector<size_t> blockStart(numBlocks);
+	for (size_t j = 0, k = 0; j < numBlocks; j++) {
+		blockStart[j] = k;
+		k += shortDataLen + (j < numShortBlocks ? 0 : 1);
+	}
+	for (size_t i = 0; i < shortDataLen; i++) {
+		uint8_t *column = &result[i * numBlocks];
+		for (size_t j = 0; j < numBlocks; j++)
+			column[j] = data[blockStart[j] + i];
+	}
+	for (size_t j = numShortBlocks; j < numBlocks; j++)
+		result[shortDataLen * numBlocks + j - numShortBlocks] = data[blockStart[j] + shortDataLen];
+	
+	// Compute the ECC of all blocks at once. They share one divisor, so the remainder is
+	// kept as blockEccLen rows with one lane per block, which is exactly the interleaved
+	// layout of the ECC codewords. The rows therefore live in place at the end of the result.
+	const vector<uint8_t> rsDiv = reedSolomonComputeDivisor(static_cast<int>(blockEccLen));
+	vector<int> divisorLog(blockEccLen);
+	for (size_t k = 0; k < blockEccLen; k++)
+		divisorLog[k] = RS_LOG[rsDiv[k]];
+	uint8_t *ecc = &result[data.size()];
+	vector<int> factorLog(numBlocks);
+	for (size_t i = 0; i <= shortDataLen; i++) {  // Polynomial division, one data column per step
+		size_t first = i < shortDataLen ? 0 : numShortBlocks;
+		for (size_t j = first; j < numBlocks; j++)
+			factorLog[j] = RS_LOG[data[blockStart[j] + i] ^ ecc[j]];
+		for (size_t k = 0; k + 1 < blockEccLen; k++) {  // Shift each lane by one row and add factor * divisor
+			uint8_t *row = &ecc[k * numBlocks];
+			const uint8_t *next = row + numBlocks;
+			const uint8_t *exp = &RS_EXP[static_cast<size_t>(divisorLog[k])];
+			for (size_t j = first; j < numBlocks; j++)
+				row[j] = next[j] ^ exp[factorLog[j]];
 		}
+		uint8_t *last = &ecc[(blockEccLen - 1) * numBlocks];
+		const uint8_t *exp = &RS_EXP[static_cast<size_t>(divisorLog[blockEccLen - 1])];
+		for (size_t j = first; j < numBlocks; j++)
+			last[j] = exp[factorLog[j]];
 	}
-	assert(result.size() == static_cast<unsigned int>(rawCodewords));
 	return result;
 }
 
@@ -661,6 +903,60 @@ long QrCode::getPenaltyScore() const {
 }
 
 
+long QrCode::getApproximatePenaltyScore() const {
+	long result = 0;
+	
+	// Adjacent modules in every other row having same color, and finder-like patterns
+	for (int y = 0; y < size; y += 2) {
+		const vector<bool> &row = modules[static_cast<size_t>(y)];
+		bool runColor = false;
+		int runX = 0;
+		std::array<int,7> runHistory = {};
+		for (int x = 0; x < size; x++) {
+			bool color = row[static_cast<size_t>(x)];
+			if (color == runColor) {
+				runX++;
+				if (runX == 5)
+					result += PENALTY_N1;
+				else if (runX > 5)
+					result++;
+			} else {
+				finderPenaltyAddHistory(runX, runHistory);
+				if (!runColor)
+					result += finderPenaltyCountPatterns(runHistory) * PENALTY_N3;
+				runColor = color;
+				runX = 1;
+			}
+		}
+		result += finderPenaltyTerminateAndCount(runColor, runX, runHistory) * PENALTY_N3;
+	}
+	// Adjacent modules in every other column having same color, and finder-like patterns
+	for (int x = 0; x < size; x += 2) {
+		bool runColor = false;
+		int runY = 0;
+		std::array<int,7> runHistory = {};
+		for (int y = 0; y < size; y++) {
+			bool color = modules[static_cast<size_t>(y)][static_cast<size_t>(x)];
+			if (color == runColor) {
+				runY++;
+				if (runY == 5)
+					result += PENALTY_N1;
+				else if (runY > 5)
+					result++;
+			} else {
+				finderPenaltyAddHistory(runY, runHistory);
+				if (!runColor)
+					result += finderPenaltyCountPatterns(runHistory) * PENALTY_N3;
+				runColor = color;
+				runY = 1;
+			}
+		}
+		result += finderPenaltyTerminateAndCount(runColor, runY, runHistory) * PENALTY_N3;
+	}
+	return result * 2;  // Scale the sample up to all rows and columns
+}
+
+
 vector<int> QrCode::getAlignmentPatternPositions() const {
 	if (version == 1)
 		return vector<int>();
@@ -789,30 +1085,418 @@ const int QrCode::PENALTY_N3 = 40;
 const int QrCode::PENALTY_N4 = 10;
 
 
-const int8_t QrCode::ECC_CODEWORDS_PER_BLOCK[4][41] = {
+const int8_t QrCode::FIXED_MASKS[41] = {
 	// Version: (note that index 0 is for padding, and is set to an illegal value)
-	//0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40    Error correction level
-	{-1,  7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},  // Low
-	{-1, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28},  // Medium
-	{-1, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},  // Quartile
-	{-1, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},  // High
+	//0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40
+	-1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  4,  2,  4,  4,  4,  4,  4,  2,  4,  2,  2,  2,  2,  2,  2,  2,  2,  4,  4,  4,
 };
 
-const int8_t QrCode::NUM_ERROR_CORRECTION_BLOCKS[4][41] = {
+
+const std::array<uint8_t,1024> QrCode::RS_EXP = [] {
+	std::array<uint8_t,1024> result = {};  // Zero from index RS_LOG_ZERO on
+	uint8_t x = 1;
+	for (int i = 0; i < 255; i++, x = reedSolomonMultiply(x, 0x02)) {
+		result.at(static_cast<size_t>(i)) = x;
+		result.at(static_cast<size_t>(i + 255)) = x;
+	}
+	return result;
+}();
+
+const std::array<int,256> QrCode::RS_LOG = [] {
+	std::array<int,256> result = {};
+	result.at(0) = RS_LOG_ZERO;
+	uint8_t x = 1;
+	for (int i = 0; i < 255; i++, x = reedSolomonMultiply(x, 0x02))
+		result.at(x) = i;
+	return result;
+}();
+
+
+/*---- Class MicroQrCode ----*/
+
+MicroQrCode MicroQrCode::encodeText(const char *text, QrCode::Ecc ecl) {
+	vector<QrSegment> segs = QrSegment::makeSegments(text);
+	return encodeSegments(segs, ecl);
+}
+
+
+MicroQrCode MicroQrCode::encodeBinary(const vector<uint8_t> &data, QrCode::Ecc ecl) {
+	vector<QrSegment> segs{QrSegment::makeBytes(data)};
+	return encodeSegments(segs, ecl);
+}
+
+
+MicroQrCode MicroQrCode::encodeSegments(const vector<QrSegment> &segs, QrCode::Ecc ecl,
+		int minVersion, int maxVersion, int mask, bool boostEcl) {
+	if (!(MIN_VERSION <= minVersion && minVersion <= maxVersion && maxVersion <= MAX_VERSION) || mask < -1 || mask > 3)
+		throw std::invalid_argument("Invalid value");
+	
+	// Find the minimal version number to use, skipping versions that lack the level or a mode
+	int version, dataUsedBits, dataCapacityBits;
+	for (version = minVersion; ; version++) {
+		int symbol = getSymbolNumber(version, ecl);
+		dataCapacityBits = symbol != -1 ? DATA_BITS[symbol] : -1;
+		dataUsedBits = getTotalBits(segs, version);
+		if (dataCapacityBits != -1 && dataUsedBits != -1 && dataUsedBits <= dataCapacityBits)
+			break;  // This version number is found to be suitable
+		if (version >= maxVersion) {  // All versions in the range could not fit the given data
+			std::ostringstream sb;
+			if (dataCapacityBits == -1)
+				sb << "Error correction level not available";
+			else if (dataUsedBits == -1)
+				sb << "Segment mode not available or segment too long";
+			else {
+				sb << "Data length = " << dataUsedBits << " bits, ";
+				sb << "Max capacity = " << dataCapacityBits << " bits";
+			}
+			throw data_too_long(sb.str());
+		}
+	}
+	
+	// Increase the error correction level while the data still fits in the current version number
+	for (QrCode::Ecc newEcl : {QrCode::Ecc::MEDIUM, QrCode::Ecc::QUARTILE}) {  // From low to high
+		int symbol = getSymbolNumber(version, newEcl);
+		if (boostEcl && symbol != -1 && dataUsedBits <= DATA_BITS[symbol]) {
+			ecl = newEcl;
+			dataCapacityBits = DATA_BITS[symbol];
+		}
+	}
+	
+	// Concatenate all segments to create the data bit string
+	BitBuffer bb;
+	for (const QrSegment &seg : segs) {
+		int modeIndex = getModeIndex(seg.getMode());
+		bb.appendBits(static_cast<uint32_t>(modeIndex), version - 1);
+		bb.appendBits(static_cast<uint32_t>(seg.getNumChars()), CHAR_COUNT_BITS[modeIndex][version]);
+		bb.insert(bb.end(), seg.getData().begin(), seg.getData().end());
+	}
+	assert(bb.size() == static_cast<unsigned int>(dataUsedBits));
+	
+	// Add the terminator (3, 5, 7 or 9 bits, truncated if necessary) and pad up to a byte if applicable
+	size_t capacity = static_cast<size_t>(dataCapacityBits);
+	bb.appendBits(0, std::min(version * 2 + 1, static_cast<int>(capacity - bb.size())));
+	bb.appendBits(0, std::min((8 - static_cast<int>(bb.size() % 8)) % 8, static_cast<int>(capacity - bb.size())));
+	
+	// Pad with alternating bytes, then zeros for the final 4-bit codeword of M1 and M3
+	for (uint8_t padByte = 0xEC; capacity - bb.size() >= 8; padByte ^= 0xEC ^ 0x11)
+		bb.appendBits(padByte, 8);
+	bb.appendBits(0, static_cast<int>(capacity - bb.size()));
+	
+	// Pack bits into bytes in big endian, leaving a 4-bit final codeword in the high nibble
+	vector<uint8_t> dataCodewords((bb.size() + 7) / 8);
+	for (size_t i = 0; i < bb.size(); i++)
+		dataCodewords.at(i >> 3) |= (bb.at(i) ? 1 : 0) << (7 - (i & 7));
+	
+	// Create the Micro QR Code object
+	return MicroQrCode(version, ecl, dataCodewords, mask);
+}
+
+
+MicroQrCode::MicroQrCode(int ver, QrCode::Ecc ecl, const vector<uint8_t> &dataCodewords, int msk) :
+		// Initialize fields and check arguments
+		version(ver),
+		errorCorrectionLevel(ecl) {
+	if (ver < MIN_VERSION || ver > MAX_VERSION)
+		throw std::domain_error("Version value out of range");
+	if (msk < -1 || msk > 3)
+		throw std::domain_error("Mask value out of range");
+	int symbol = getSymbolNumber(ver, ecl);
+	if (symbol == -1)
+		throw std::domain_error("Error correction level not available in this version");
+	if (dataCodewords.size() != static_cast<unsigned int>((DATA_BITS[symbol] + 7) / 8))
+		throw std::invalid_argument("Invalid argument");
+	size = ver * 2 + 9;
+	size_t sz = static_cast<size_t>(size);
+	modules    = vector<vector<bool> >(sz, vector<bool>(sz));  // Initially all light
+	isFunction = vector<vector<bool> >(sz, vector<bool>(sz));
+	
+	// Compute ECC over the single block, draw modules
+	drawFunctionPatterns();
+	const vector<uint8_t> ecc = QrCode::reedSolomonComputeRemainder(dataCodewords,
+		QrCode::reedSolomonComputeDivisor(ECC_CODEWORDS[symbol]));
+	drawCodewords(dataCodewords, ecc);
+	
+	// Do masking
+	if (msk == -1) {  // Automatically choose the mask with the highest score
+		int maxScore = -1;
+		for (int i = 0; i < 4; i++) {
+			applyMask(i);
+			int score = getMaskScore();
+			if (score > maxScore) {
+				msk = i;
+				maxScore = score;
+			}
+			applyMask(i);  // Undoes the mask due to XOR
+		}
+	}
+	assert(0 <= msk && msk <= 3);
+	mask = msk;
+	applyMask(msk);  // Apply the final choice of mask
+	drawFormatBits(msk);  // Overwrite old format bits
+	
+	isFunction.clear();
+	isFunction.shrink_to_fit();
+}
+
+
+int MicroQrCode::getVersion() const {
+	return version;
+}
+
+
+int MicroQrCode::getSize() const {
+	return size;
+}
+
+
+QrCode::Ecc MicroQrCode::getErrorCorrectionLevel() const {
+	return errorCorrectionLevel;
+}
+
+
+int MicroQrCode::getMask() const {
+	return mask;
+}
+
+
+bool MicroQrCode::getModule(int x, int y) const {
+	return 0 <= x && x < size && 0 <= y && y < size && module(x, y);
+}
+
+
+void MicroQrCode::drawFunctionPatterns() {
+	// Draw the finder pattern in the top left corner, with its separator along the right and bottom
+	for (int y = 0; y <= 7; y++) {
+		for (int x = 0; x <= 7; x++) {
+			int dist = std::max(std::abs(x - 3), std::abs(y - 3));  // Chebyshev/infinity norm
+			setFunctionModule(x, y, dist != 2 && dist != 4);
+		}
+	}
+	
+	// Draw the timing patterns along the top row and left column
+	for (int i = 8; i < size; i++) {
+		setFunctionModule(i, 0, i % 2 == 0);
+		setFunctionModule(0, i, i % 2 == 0);
+	}
+	
+	drawFormatBits(0);  // Dummy mask value; overwritten later in the constructor
+}
+
+
+void MicroQrCode::drawFormatBits(int msk) {
+	// Calculate error correction code and pack bits
+	int data = getSymbolNumber(version, errorCorrectionLevel) << 2 | msk;  // Symbol number is uint3, msk is uint2
+	int rem = data;
+	for (int i = 0; i < 10; i++)
+		rem = (rem << 1) ^ ((rem >> 9) * 0x537);
+	int bits = (data << 10 | rem) ^ 0x4445;  // uint15
+	assert(bits >> 15 == 0);
+	
+	// Draw the only copy, down column 8 and then leftward along row 8
+	for (int i = 0; i < 8; i++)
+		setFunctionModule(8, i + 1, QrCode::getBit(bits, i));
+	for (int i = 8; i < 15; i++)
+		setFunctionModule(15 - i, 8, QrCode::getBit(bits, i));
+}
+
+
+void MicroQrCode::setFunctionModule(int x, int y, bool isDark) {
+	size_t ux = static_cast<size_t>(x);
+	size_t uy = static_cast<size_t>(y);
+	modules   .at(uy).at(ux) = isDark;
+	isFunction.at(uy).at(ux) = true;
+}
+
+
+bool MicroQrCode::module(int x, int y) const {
+	return modules.at(static_cast<size_t>(y)).at(static_cast<size_t>(x));
+}
+
+
+void MicroQrCode::drawCodewords(const vector<uint8_t> &data, const vector<uint8_t> &ecc) {
+	// Lay out the bit sequence, where the final data codeword of M1 and M3 is only 4 bits
+	size_t dataBits = static_cast<size_t>(DATA_BITS[getSymbolNumber(version, errorCorrectionLevel)]);
+	BitBuffer bb;
+	for (size_t i = 0; i < dataBits; i += 8)
+		bb.appendBits(static_cast<uint32_t>(data.at(i >> 3) >> (dataBits - i < 8 ? 4 : 0)), std::min(8, static_cast<int>(dataBits - i)));
+	for (uint8_t b : ecc)
+		bb.appendBits(b, 8);
+	
+	size_t i = 0;  // Bit index into the sequence
+	// Do the zigzag scan over column pairs, alternating direction and starting upward
+	bool upward = true;
+	for (int right = size - 1; right >= 1; right -= 2, upward = !upward) {  // Column 0 is the timing pattern
+		for (int vert = 0; vert < size; vert++) {  // Vertical counter
+			for (int j = 0; j < 2; j++) {
+				size_t x = static_cast<size_t>(right - j);  // Actual x coordinate
+				size_t y = static_cast<size_t>(upward ? size - 1 - vert : vert);  // Actual y coordinate
+				if (!isFunction.at(y).at(x) && i < bb.size()) {
+					modules.at(y).at(x) = bb.at(i);
+					i++;
+				}
+			}
+		}
+	}
+	assert(i == bb.size());
+}
+
+
+void MicroQrCode::applyMask(int msk) {
+	if (msk < 0 || msk > 3)
+		throw std::domain_error("Mask value out of range");
+	size_t sz = static_cast<size_t>(size);
+	for (size_t y = 0; y < sz; y++) {
+		for (size_t x = 0; x < sz; x++) {
+			bool invert;
+			switch (msk) {
+				case 0:  invert = y % 2 == 0;                          break;
+				case 1:  invert = (x / 3 + y / 2) % 2 == 0;            break;
+				case 2:  invert = (x * y % 2 + x * y % 3) % 2 == 0;    break;
+				case 3:  invert = ((x + y) % 2 + x * y % 3) % 2 == 0;  break;
+				default:  throw std::logic_error("Unreachable");
+			}
+			modules.at(y).at(x) = modules.at(y).at(x) ^ (invert & !isFunction.at(y).at(x));
+		}
+	}
+}
+
+
+int MicroQrCode::getMaskScore() const {
+	// Count dark modules on the right and bottom edges, excluding the timing pattern modules
+	int sum1 = 0, sum2 = 0;
+	for (int i = 1; i < size; i++) {
+		sum1 += module(size - 1, i) ? 1 : 0;
+		sum2 += module(i, size - 1) ? 1 : 0;
+	}
+	return sum1 <= sum2 ? sum1 * 16 + sum2 : sum2 * 16 + sum1;
+}
+
+
+int MicroQrCode::getSymbolNumber(int ver, QrCode::Ecc ecl) {
+	return SYMBOL_NUMBERS[static_cast<int>(ecl)][ver];
+}
+
+
+int MicroQrCode::getTotalBits(const vector<QrSegment> &segs, int ver) {
+	long result = 0;
+	for (const QrSegment &seg : segs) {
+		int modeIndex = getModeIndex(seg.getMode());
+		if (modeIndex == -1)
+			return -1;
+		int ccbits = CHAR_COUNT_BITS[modeIndex][ver];
+		if (ccbits == 0 || seg.getNumChars() >= (1L << ccbits))
+			return -1;  // Mode not available in this version, or the segment's length doesn't fit the field's bit width
+		result += (ver - 1) + ccbits + static_cast<long>(seg.getData().size());
+		if (result > INT_MAX)
+			return -1;  // The sum will overflow an int type
+	}
+	return static_cast<int>(result);
+}
+
+
+int MicroQrCode::getModeIndex(const QrSegment::Mode &mode) {
+	if (&mode == &QrSegment::Mode::NUMERIC)
+		return 0;
+	else if (&mode == &QrSegment::Mode::ALPHANUMERIC)
+		return 1;
+	else if (&mode == &QrSegment::Mode::BYTE)
+		return 2;
+	else if (&mode == &QrSegment::Mode::KANJI)
+		return 3;
+	else
+		return -1;  // ECI is not available in Micro QR Codes
+}
+
+
+const int8_t MicroQrCode::SYMBOL_NUMBERS[4][5] = {
 	// Version: (note that index 0 is for padding, and is set to an illegal value)
-	//0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40    Error correction level
-	{-1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4,  4,  4,  4,  4,  6,  6,  6,  6,  7,  8,  8,  9,  9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25},  // Low
-	{-1, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5,  5,  8,  9,  9, 10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49},  // Medium
-	{-1, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8,  8, 10, 12, 16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68},  // Quartile
-	{-1, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81},  // High
+	//0, M1, M2, M3, M4    Error correction level
+	{-1,  0,  1,  3,  5},  // Low (error detection only for M1)
+	{-1, -1,  2,  4,  6},  // Medium
+	{-1, -1, -1, -1,  7},  // Quartile
+	{-1, -1, -1, -1, -1},  // High
+};
+
+
+const std::int16_t MicroQrCode::DATA_BITS[8] = {
+	// M1, M2-L, M2-M, M3-L, M3-M, M4-L, M4-M, M4-Q
+	   20,   40,   32,   84,   68,  128,  112,   80,
+};
+
+
+const int8_t MicroQrCode::ECC_CODEWORDS[8] = {
+	// M1, M2-L, M2-M, M3-L, M3-M, M4-L, M4-M, M4-Q
+	    2,    5,    6,    6,    8,    8,   10,   14,
 };
 
 
+const int8_t MicroQrCode::CHAR_COUNT_BITS[4][5] = {
+	//0, M1, M2, M3, M4    Mode
+	{-1,  3,  4,  5,  6},  // Numeric
+	{-1,  0,  3,  4,  5},  // Alphanumeric
+	{-1,  0,  0,  4,  5},  // Byte
+	{-1,  0,  0,  3,  4},  // Kanji
+};
+
+
+
 data_too_long::data_too_long(const std::string &msg) :
 	std::length_error(msg) {}
 
 
 
+/*---- Class EncodeResult ----*/
+
+EncodeResult::EncodeResult(QrCode qr) :
+	code(std::move(qr)),
+	dataUsedBits(0),
+	dataCapacityBits(0) {}
+
+
+EncodeResult::EncodeResult(int usedBits, int capacityBits) :
+	dataUsedBits(usedBits),
+	dataCapacityBits(capacityBits) {}
+
+
+bool EncodeResult::hasValue() const {
+	return code.has_value();
+}
+
+
+EncodeResult::operator bool() const {
+	return code.has_value();
+}
+
+
+const QrCode &EncodeResult::value() const {
+	throwIfEmpty();
+	return *code;
+}
+
+
+QrCode EncodeResult::takeValue() {
+	throwIfEmpty();
+	return std::move(*code);
+}
+
+
+int EncodeResult::getDataUsedBits() const {
+	return dataUsedBits;
+}
+
+
+int EncodeResult::getDataCapacityBits() const {
+	return dataCapacityBits;
+}
+
+
+void EncodeResult::throwIfEmpty() const {
+	if (!code.has_value())
+		throw data_too_long(tooLongMessage(dataUsedBits, dataCapacityBits));
+}
+
+
+
 /*---- Class BitBuffer ----*/
 
 BitBuffer::BitBuffer()
@@ -826,4 +1510,21 @@ void BitBuffer::appendBits(std::uint32_t val, int len) {
 		this->push_back(((val >> i) & 1) != 0);
 }
 
+
+void BitBuffer::orBits(std::size_t pos, std::uint32_t val, int len) {
+	if (len < 0 || len > 31 || val >> len != 0 || pos > this->size() || static_cast<size_t>(len) > this->size() - pos)
+		throw std::domain_error("Value out of range");
+	size_t end = pos + static_cast<size_t>(len);
+	for (; val != 0; val &= val - 1) {  // Touch only the 1 bits, lowest first
+#if defined(__GNUC__)
+		int i = __builtin_ctz(val);
+#else
+		int i = 0;
+		while (((val >> i) & 1) == 0)
+			i++;
+#endif
+		(*this)[end - 1 - static_cast<size_t>(i)] = true;
+	}
+}
+
 }
@@ -24,7 +24,9 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -32,6 +34,9 @@
 
 namespace qrcodegen {
 
+class EncodeDiagnostics;
+class EncodeResult;
+
 /* 
  * A segment of character/binary/control data in a QR Code symbol.
  * Instances of this class are immutable.
@@ -207,11 +212,35 @@ class QrSegment final {
 	public: static int getTotalBits(const std::vector<QrSegment> &segs, int version);
 	
 	
-	/*---- Private constant ----*/
+	/*---- Private helper functions ----*/
+	
+	// Returns the bitwise AND of the CHARACTER_CLASSES flags (CLASS_NUMERIC, CLASS_ALPHANUMERIC)
+	// over the given len characters, i.e. the set of modes that can encode the whole text.
+	// Uses a 16/32-byte SIMD scan when compiled with SSE2/AVX2, and the lookup table otherwise.
+	private: static int classifyText(const char *text, std::size_t len);
+	
+	
+	/*---- Constants ----*/
 	
 	/* The set of all legal characters in alphanumeric mode, where
 	 * each character value maps to the index in the string. */
-	private: static const char *ALPHANUMERIC_CHARSET;
+	private: static constexpr const char *ALPHANUMERIC_CHARSET = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
+	
+	// (Package-private) Flag bits in CHARACTER_CLASSES.
+	public: static constexpr int CLASS_NUMERIC      = 0x80;
+	public: static constexpr int CLASS_ALPHANUMERIC = 0x40;
+	
+	/* (Package-private) For each byte value, the CLASS_* flags of the modes that can encode it, ORed
+	 * with its index in ALPHANUMERIC_CHARSET in the low 6 bits (zero if not alphanumeric).
+	 * Built at compile time, so it can also be used in constant expressions. */
+	public: static constexpr std::array<std::uint8_t,256> CHARACTER_CLASSES = [] {
+		std::array<std::uint8_t,256> result = {};
+		for (int i = 0; ALPHANUMERIC_CHARSET[i] != '\0'; i++)
+			result[static_cast<std::uint8_t>(ALPHANUMERIC_CHARSET[i])] = static_cast<std::uint8_t>(CLASS_ALPHANUMERIC | i);
+		for (char c = '0'; c <= '9'; c++)
+			result[static_cast<std::uint8_t>(c)] |= CLASS_NUMERIC;
+		return result;
+	}();
 	
 };
 
@@ -252,6 +281,23 @@ class QrCode final {
 	private: static int getFormatBits(Ecc ecl);
 	
 	
+	/* 
+	 * How the mask is chosen when automatic masking (mask = -1) is requested.
+	 */
+	public: enum class MaskStrategy {
+		EXACT,  // Score all 8 masks with the full penalty rules and take the lowest (slowest)
+		FAST ,  // Rank all 8 masks by a sampled penalty, then score only the best two in full
+		FIXED,  // Use a per-version mask from a table derived from a corpus, with no scoring
+	};
+	
+	
+	// The compile-time specialised encoder reads the block layout tables.
+	template <int VER, Ecc ECL> friend class QrCodeFixed;
+	
+	// Micro QR Codes share the Reed-Solomon and format BCH code.
+	friend class MicroQrCode;
+	
+	
 	
 	/*---- Static factory functions (high level) ----*/
 	
@@ -283,12 +329,58 @@ class QrCode final {
 	 * may be higher than the ecl argument if it can be done without increasing the
 	 * version. The mask number is either between 0 to 7 (inclusive) to force that
 	 * mask, or -1 to automatically choose an appropriate mask (which may be slow).
+	 * The strategy picks how hard the automatic choice works; only EXACT always yields
+	 * the lowest penalty score, the others trade a slightly higher score for speed.
 	 * This function allows the user to create a custom sequence of segments that switches
 	 * between modes (such as alphanumeric and byte) to encode text in less space.
+	 * If diagnostics is not null, it receives a record of how the QR Code was made.
 	 * This is a mid-level API; the high-level API is encodeText() and encodeBinary().
 	 */
 	public: static QrCode encodeSegments(const std::vector<QrSegment> &segs, Ecc ecl,
-		int minVersion=1, int maxVersion=40, int mask=-1, bool boostEcl=true);  // All optional parameters
+		int minVersion=1, int maxVersion=40, int mask=-1, bool boostEcl=true,
+		MaskStrategy strategy=MaskStrategy::EXACT, EncodeDiagnostics *diagnostics=nullptr);  // All optional parameters
+	
+	
+	/* 
+	 * Performs the first half of encodeSegments() without building a symbol: chooses the version
+	 * and (iff boostEcl is true) boosts the ECC level in the same way, stores both in the given
+	 * references, and returns the padded data codewords for the constructor. This lets a caller
+	 * build the mask candidates itself, for example on several threads. Throws data_too_long
+	 * under the same conditions as encodeSegments(). If diagnostics is not null, its segment,
+	 * capacity and level fields and segmentCycles are filled in.
+	 */
+	public: static std::vector<std::uint8_t> makeDataCodewords(const std::vector<QrSegment> &segs,
+		Ecc &ecl, int &version, int minVersion=1, int maxVersion=40, bool boostEcl=true,
+		EncodeDiagnostics *diagnostics=nullptr);
+	
+	
+	/* 
+	 * Like encodeSegments(), but reports data that does not fit any version in the range through
+	 * the result instead of throwing data_too_long, so that callers probing many candidate
+	 * payloads pay neither for an exception nor for formatting its message on each miss.
+	 * Invalid arguments still throw as in encodeSegments().
+	 */
+	public: static EncodeResult tryEncodeSegments(const std::vector<QrSegment> &segs, Ecc ecl,
+		int minVersion=1, int maxVersion=40, int mask=-1, bool boostEcl=true,
+		MaskStrategy strategy=MaskStrategy::EXACT, EncodeDiagnostics *diagnostics=nullptr);  // All optional parameters
+	
+	
+	/* 
+	 * Returns the version that encodeSegments() would choose for the given segments and range,
+	 * or -1 if the data fits none of them, without encoding anything.
+	 */
+	public: static int getMinVersion(const std::vector<QrSegment> &segs, Ecc ecl,
+		int minVersion=1, int maxVersion=40);
+	
+	
+	/* 
+	 * Returns the largest number of characters that a single segment of the given mode can hold
+	 * in a QR Code of the given version and error correction level: digits for NUMERIC, characters
+	 * for ALPHANUMERIC, bytes for BYTE and double-byte characters for KANJI. The answer comes from
+	 * a table built on first use, so chunking code can find split points without encode attempts.
+	 * Throws std::invalid_argument for ECI mode or a version out of range.
+	 */
+	public: static int getMaxPayload(int ver, Ecc ecl, const QrSegment::Mode &mode);
 	
 	
 	
@@ -328,10 +420,13 @@ class QrCode final {
 	/* 
 	 * Creates a new QR Code with the given version number,
 	 * error correction level, data codeword bytes, and mask number.
+	 * The strategy only matters when msk is -1 (see encodeSegments()). If diagnostics is not
+	 * null, its mask penalty fields and the cycle counts of the later phases are filled in.
 	 * This is a low-level API that most users should not use directly.
 	 * A mid-level API is the encodeSegments() function.
 	 */
-	public: QrCode(int ver, Ecc ecl, const std::vector<std::uint8_t> &dataCodewords, int msk);
+	public: QrCode(int ver, Ecc ecl, const std::vector<std::uint8_t> &dataCodewords, int msk,
+		MaskStrategy strategy=MaskStrategy::EXACT, EncodeDiagnostics *diagnostics=nullptr);
 	
 	
 	
@@ -369,6 +464,14 @@ class QrCode final {
 	public: bool getModule(int x, int y) const;
 	
 	
+	/* 
+	 * Returns the penalty score of this QR Code's modules under the standard masking rules, which
+	 * the automatic mask choice minimises (lower is better). For a code built with a forced mask,
+	 * this is the score that mask received when chosen automatically with MaskStrategy::EXACT.
+	 */
+	public: long getPenaltyScore() const;
+	
+	
 	
 	/*---- Private helper methods for constructor: Drawing function modules ----*/
 	
@@ -425,9 +528,10 @@ class QrCode final {
 	private: void applyMask(int msk);
 	
 	
-	// Calculates and returns the penalty score based on state of this QR Code's current modules.
-	// This is used by the automatic mask choice algorithm to find the mask pattern that yields the lowest score.
-	private: long getPenaltyScore() const;
+	// Estimates the penalty score from the same-color run and finder-like rules, evaluated over every other
+	// row and column only. It is several times cheaper than getPenaltyScore(), and is only used to rank
+	// masks for MaskStrategy::FAST.
+	private: long getApproximatePenaltyScore() const;
 	
 	
 	
@@ -497,9 +601,330 @@ class QrCode final {
 	private: static const int PENALTY_N3;
 	private: static const int PENALTY_N4;
 	
+	// For MaskStrategy::FIXED, the mask to use for each version.
+	private: static const std::int8_t FIXED_MASKS[41];
+	
+	
+	private: static constexpr std::int8_t ECC_CODEWORDS_PER_BLOCK[4][41] = {
+		// Version: (note that index 0 is for padding, and is set to an illegal value)
+		//0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40    Error correction level
+		{-1,  7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},  // Low
+		{-1, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28},  // Medium
+		{-1, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},  // Quartile
+		{-1, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},  // High
+	};
+	
+	private: static constexpr std::int8_t NUM_ERROR_CORRECTION_BLOCKS[4][41] = {
+		// Version: (note that index 0 is for padding, and is set to an illegal value)
+		//0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40    Error correction level
+		{-1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4,  4,  4,  4,  4,  6,  6,  6,  6,  7,  8,  8,  9,  9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25},  // Low
+		{-1, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5,  5,  8,  9,  9, 10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49},  // Medium
+		{-1, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8,  8, 10, 12, 16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68},  // Quartile
+		{-1, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81},  // High
+	};
+	
+	
+	// Powers of the generator 0x02 of GF(2^8/0x11D), repeated twice, and their discrete logarithms.
+	// The logarithm of 0 is RS_LOG_ZERO and RS_EXP is 0 from there on, so RS_EXP[RS_LOG[x] + RS_LOG[y]]
+	// is the product of x and y for all field elements, including zero, without any branches.
+	private: static constexpr int RS_LOG_ZERO = 510;
+	private: static const std::array<std::uint8_t,1024> RS_EXP;
+	private: static const std::array<int,256> RS_LOG;
+	
+};
+
+
+
+/* 
+ * A record of how one QR Code was encoded: which masks scored what, how much of the capacity
+ * the data used, the segments it was made of, whether boostEcl raised the level, and how long
+ * each phase took. It exists to find out where encode time and capacity go on real payloads.
+ * The encoder only fills one in when passed a pointer to it; with the default null pointer,
+ * each phase costs one untaken branch more and nothing is measured or stored.
+ * Cycle counts are processor timestamp ticks on x86, and nanoseconds elsewhere.
+ */
+class EncodeDiagnostics final {
+	
+	/*---- Public helper structure ----*/
+	
+	public: struct Segment final {
+		int modeBits;   // As QrSegment::Mode::getModeBits()
+		int numChars;
+		int dataBits;   // Excluding the mode indicator and character count
+	};
+	
+	
+	/*---- Fields ----*/
+	
+	public: std::vector<Segment> segments;
+	
+	// Segment headers and data, before the terminator and padding, and the data capacity of
+	// the chosen version and level
+	public: int dataUsedBits = 0;
+	public: int dataCapacityBits = 0;
+	
+	public: QrCode::Ecc requestedEcl = QrCode::Ecc::LOW;
+	public: QrCode::Ecc chosenEcl = QrCode::Ecc::LOW;  // Differs iff boostEcl raised the level
+	
+	// Penalty score of each mask as the strategy scored it (sampled ones for MaskStrategy::FAST),
+	// or -1 for a mask that was not scored, as when the mask is forced or taken from a table
+	public: std::array<long,8> maskPenalties{{-1, -1, -1, -1, -1, -1, -1, -1}};
+	
+	public: long long segmentCycles = 0;    // Choosing the version and assembling the data bits
+	public: long long eccCycles = 0;        // Reed-Solomon codewords and interleaving
+	public: long long placementCycles = 0;  // Function patterns and codeword placement
+	public: long long maskCycles = 0;       // Scoring masks and applying the chosen one
+	
+};
+
+
+
+/* 
+ * The outcome of QrCode::tryEncodeSegments(): either the QR Code, or the number of data bits
+ * the segments needed and the capacity of the largest version tried, which tell the caller
+ * by how much the data missed. A needed size of -1 means a segment is too long for the
+ * character count field of every version tried.
+ */
+class EncodeResult final {
+	
+	/*---- Constructors ----*/
+	
+	public: explicit EncodeResult(QrCode qr);
+	
+	public: EncodeResult(int dataUsedBits, int dataCapacityBits);
+	
+	
+	/*---- Methods ----*/
+	
+	public: bool hasValue() const;
+	
+	public: explicit operator bool() const;
+	
+	// Returns the QR Code, or throws data_too_long with the message encodeSegments() would have given.
+	public: const QrCode &value() const;
+	
+	// Like value(), but moves the QR Code out of this result.
+	public: QrCode takeValue();
+	
+	// Returns the data bits the segments needed, or -1 (see above). Only meaningful without a value.
+	public: int getDataUsedBits() const;
+	
+	// Returns the data bit capacity of the largest version tried. Only meaningful without a value.
+	public: int getDataCapacityBits() const;
+	
+	
+	/*---- Fields ----*/
+	
+	private: std::optional<QrCode> code;
+	private: int dataUsedBits;
+	private: int dataCapacityBits;
+	
+	
+	/*---- Private helper ----*/
+	
+	private: void throwIfEmpty() const;
+	
+};
+
+
+
+/* 
+ * A Micro QR Code symbol, which is a square grid of dark and light cells with a single finder
+ * pattern. Versions M1 to M4 (numbered 1 to 4 here) are 11*11 to 17*17 modules and need only
+ * a 2-module quiet zone, so they are much smaller than a version 1 QR Code for short payloads
+ * such as IDs and PINs. Segments, bit buffers and the Reed-Solomon code are shared with QrCode.
+ * Supported combinations, per ISO/IEC 18004:
+ * - M1: numeric mode only, error detection only (requested as Ecc::LOW).
+ * - M2: numeric and alphanumeric modes, Ecc::LOW or Ecc::MEDIUM.
+ * - M3: numeric, alphanumeric, byte and kanji modes, Ecc::LOW or Ecc::MEDIUM.
+ * - M4: numeric, alphanumeric, byte and kanji modes, Ecc::LOW, Ecc::MEDIUM or Ecc::QUARTILE.
+ * ECI segments and Ecc::HIGH are not available in any Micro QR Code.
+ * Instances of this class are immutable.
+ */
+class MicroQrCode final {
+	
+	/*---- Static factory functions (high level) ----*/
+	
+	/* 
+	 * Returns a Micro QR Code representing the given Unicode text string at the given error correction
+	 * level, using the smallest version that fits. The error correction level may be higher than
+	 * requested if this does not increase the version. Throws data_too_long if the text does not fit
+	 * in an M4 symbol at the given level (at most 35 digits, or 15 bytes of UTF-8 at Ecc::LOW).
+	 */
+	public: static MicroQrCode encodeText(const char *text, QrCode::Ecc ecl);
+	
+	
+	/* 
+	 * Returns a Micro QR Code representing the given binary data at the given error correction level.
+	 * This function always encodes using byte mode, so it needs an M3 or M4 symbol.
+	 * Throws data_too_long if the data does not fit.
+	 */
+	public: static MicroQrCode encodeBinary(const std::vector<std::uint8_t> &data, QrCode::Ecc ecl);
+	
+	
+	/*---- Static factory function (mid level) ----*/
+	
+	/* 
+	 * Returns a Micro QR Code representing the given segments with the given encoding parameters.
+	 * The smallest possible version within the given range is automatically chosen for the output.
+	 * Iff boostEcl is true, then the ECC level of the result may be higher than the ecl argument
+	 * if it can be done without increasing the version. The mask number is either between 0 to 3
+	 * (inclusive) to force that mask, or -1 to automatically choose the mask with the best score.
+	 * Versions and levels that cannot hold the segments' modes are skipped, and data_too_long is
+	 * thrown if no version in the range fits.
+	 */
+	public: static MicroQrCode encodeSegments(const std::vector<QrSegment> &segs, QrCode::Ecc ecl,
+		int minVersion=1, int maxVersion=4, int mask=-1, bool boostEcl=true);  // All optional parameters
+	
+	
+	
+	/*---- Instance fields ----*/
+	
+	// Immutable scalar parameters:
+	
+	/* The version number of this Micro QR Code, which is between 1 and 4 (inclusive) for M1 to M4. */
+	private: int version;
+	
+	/* The width and height of this Micro QR Code, measured in modules, between
+	 * 11 and 17 (inclusive). This is equal to version * 2 + 9. */
+	private: int size;
+	
+	/* The error correction level used in this Micro QR Code. Always LOW for M1. */
+	private: QrCode::Ecc errorCorrectionLevel;
+	
+	/* The index of the mask pattern used in this Micro QR Code, which is between 0 and 3 (inclusive). */
+	private: int mask;
+	
+	// The modules of this Micro QR Code (false = light, true = dark).
+	// Immutable after constructor finishes. Accessed through getModule().
+	private: std::vector<std::vector<bool> > modules;
+	
+	// Indicates function modules that are not subjected to masking. Discarded when constructor finishes.
+	private: std::vector<std::vector<bool> > isFunction;
+	
+	
+	
+	/*---- Constructor (low level) ----*/
+	
+	/* 
+	 * Creates a new Micro QR Code with the given version number, error correction level, data
+	 * codeword bytes, and mask number. For M1 and M3 the final data codeword holds only 4 bits,
+	 * which are taken from the high nibble of the last byte. This is a low-level API that most
+	 * users should not use directly. A mid-level API is the encodeSegments() function.
+	 */
+	public: MicroQrCode(int ver, QrCode::Ecc ecl, const std::vector<std::uint8_t> &dataCodewords, int msk);
+	
+	
+	
+	/*---- Public instance methods ----*/
+	
+	/* 
+	 * Returns this Micro QR Code's version, in the range [1, 4].
+	 */
+	public: int getVersion() const;
+	
+	
+	/* 
+	 * Returns this Micro QR Code's size, in the range [11, 17].
+	 */
+	public: int getSize() const;
+	
 	
-	private: static const std::int8_t ECC_CODEWORDS_PER_BLOCK[4][41];
-	private: static const std::int8_t NUM_ERROR_CORRECTION_BLOCKS[4][41];
+	/* 
+	 * Returns this Micro QR Code's error correction level.
+	 */
+	public: QrCode::Ecc getErrorCorrectionLevel() const;
+	
+	
+	/* 
+	 * Returns this Micro QR Code's mask, in the range [0, 3].
+	 */
+	public: int getMask() const;
+	
+	
+	/* 
+	 * Returns the color of the module (pixel) at the given coordinates, which is false
+	 * for light or true for dark. The top left corner has the coordinates (x=0, y=0).
+	 * If the given coordinates are out of bounds, then false (light) is returned.
+	 */
+	public: bool getModule(int x, int y) const;
+	
+	
+	
+	/*---- Private helper methods for constructor ----*/
+	
+	// Draws and marks the finder pattern, its separator, the two timing patterns and the format area.
+	private: void drawFunctionPatterns();
+	
+	
+	// Draws the single copy of the format bits, based on the given mask
+	// and this object's version and error correction level fields.
+	private: void drawFormatBits(int msk);
+	
+	
+	// Sets the color of a module and marks it as a function module.
+	// Only used by the constructor. Coordinates must be in bounds.
+	private: void setFunctionModule(int x, int y, bool isDark);
+	
+	
+	// Returns the color of the module at the given coordinates, which must be in range.
+	private: bool module(int x, int y) const;
+	
+	
+	// Draws the data codewords followed by the given error correction codewords onto the data area,
+	// in the same zigzag order as QrCode but with no timing column to skip.
+	private: void drawCodewords(const std::vector<std::uint8_t> &data, const std::vector<std::uint8_t> &ecc);
+	
+	
+	// XORs the codeword modules with the given Micro QR mask pattern (0 to 3), which are the
+	// QR Code mask patterns 1, 4, 6 and 7. Calling it a second time with the same mask undoes it.
+	private: void applyMask(int msk);
+	
+	
+	// Returns the mask evaluation score from the dark modules along the right and bottom edges.
+	// Unlike QrCode's penalty score, the mask with the highest score is chosen.
+	private: int getMaskScore() const;
+	
+	
+	
+	/*---- Private helper functions ----*/
+	
+	// Returns the symbol number (0 to 7) encoded in the format bits for the given version and error
+	// correction level, or -1 if the version does not support that level.
+	private: static int getSymbolNumber(int ver, QrCode::Ecc ecl);
+	
+	
+	// Returns the number of bits needed to encode the given segments in the given version, or -1 if a
+	// segment's mode is not available in that version or has too many characters for its count field.
+	private: static int getTotalBits(const std::vector<QrSegment> &segs, int ver);
+	
+	
+	// Returns the Micro QR mode indicator value (0 to 3) for the given segment mode, or -1 for ECI.
+	private: static int getModeIndex(const QrSegment::Mode &mode);
+	
+	
+	
+	/*---- Constants and tables ----*/
+	
+	// The minimum version number (M1) of a Micro QR Code.
+	public: static constexpr int MIN_VERSION = 1;
+	
+	// The maximum version number (M4) of a Micro QR Code.
+	public: static constexpr int MAX_VERSION = 4;
+	
+	// The width of the light border that a Micro QR Code needs on each side, in modules.
+	public: static constexpr int QUIET_ZONE = 2;
+	
+	
+	// Symbol number by error correction level and version, or -1 if the combination does not exist.
+	private: static const std::int8_t SYMBOL_NUMBERS[4][5];
+	
+	// Data capacity in bits and number of error correction codewords, by symbol number.
+	private: static const std::int16_t DATA_BITS[8];
+	private: static const std::int8_t ECC_CODEWORDS[8];
+	
+	// Character count field width by mode index and version, or 0 if the mode is not available.
+	private: static const std::int8_t CHAR_COUNT_BITS[4][5];
 	
 };
 
@@ -538,12 +963,18 @@ class BitBuffer final : public std::vector<bool> {
 	
 	
 	
-	/*---- Method ----*/
+	/*---- Methods ----*/
 	
 	// Appends the given number of low-order bits of the given value
 	// to this buffer. Requires 0 <= len <= 31 and val < 2^len.
 	public: void appendBits(std::uint32_t val, int len);
 	
+	
+	// ORs the given number of low-order bits of the given value into this buffer, with the most
+	// significant bit at index pos. Meant for filling a buffer that was pre-sized with zeros, which
+	// is much faster than appending. Requires 0 <= len <= 31, val < 2^len and pos + len <= size().
+	public: void orBits(std::size_t pos, std::uint32_t val, int len);
+	
 };
 
 }
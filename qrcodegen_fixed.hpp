@@ -0,0 +1,646 @@
+/* 
+ * QR Code generator library (C++), compile-time specialised encoder
+ * 
+ * QrCodeFixed<VERSION, ECL> produces exactly the same symbols as QrCode for one
+ * version and error correction level that are known at compile time. Everything
+ * that depends only on the format (function patterns, Reed-Solomon divisor, block
+ * layout, codeword placement order) is a constant table, and the module grid is a
+ * std::array of exactly the right size, so no vectors are allocated while encoding.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "qrcodegen.hpp"
+
+
+namespace qrcodegen {
+
+/* 
+ * A QR Code symbol whose version and error correction level are template parameters.
+ * Instances are immutable. For the same segments and mask argument, the modules are
+ * identical to QrCode::encodeSegments(segs, ECL, VERSION, VERSION, mask, false),
+ * i.e. the version is fixed and the error correction level is never boosted.
+ * 
+ * Ways to create a QrCodeFixed object:
+ * - High level: Take the text and call encodeText(), which also works at compile time.
+ * - Mid level: Custom-make the list of segments and call encodeSegments().
+ * - Low level: Supply exactly NUM_DATA_CODEWORDS data codeword bytes (including segment
+ *   headers and final padding) to encodeCodewords(), which is also usable at compile time.
+ */
+template <int VERSION, QrCode::Ecc ECL>
+class QrCodeFixed final {
+	
+	static_assert(QrCode::MIN_VERSION <= VERSION && VERSION <= QrCode::MAX_VERSION, "Version number out of range");
+	
+	
+	/*---- Public constants ----*/
+	
+	// The width and height of this QR Code, measured in modules.
+	public: static constexpr int SIZE = VERSION * 4 + 17;
+	
+	// The number of data bits that fit in this format, after all function modules are excluded.
+	// Same as QrCode::getNumRawDataModules(VERSION).
+	private: static constexpr int NUM_RAW_DATA_MODULES = (16 * VERSION + 128) * VERSION + 64
+		- (VERSION < 2 ? 0 : (25 * (VERSION / 7 + 2) - 10) * (VERSION / 7 + 2) - 55 + (VERSION < 7 ? 0 : 36));
+	
+	private: static constexpr int NUM_BLOCKS = QrCode::NUM_ERROR_CORRECTION_BLOCKS[static_cast<int>(ECL)][VERSION];
+	private: static constexpr int BLOCK_ECC_LEN = QrCode::ECC_CODEWORDS_PER_BLOCK[static_cast<int>(ECL)][VERSION];
+	private: static constexpr int NUM_RAW_CODEWORDS = NUM_RAW_DATA_MODULES / 8;
+	private: static constexpr int NUM_SHORT_BLOCKS = NUM_BLOCKS - NUM_RAW_CODEWORDS % NUM_BLOCKS;
+	private: static constexpr int SHORT_DATA_LEN = NUM_RAW_CODEWORDS / NUM_BLOCKS - BLOCK_ECC_LEN;
+	
+	// The number of 8-bit data (i.e. not error correction) codewords in this format.
+	public: static constexpr int NUM_DATA_CODEWORDS = NUM_RAW_CODEWORDS - NUM_BLOCKS * BLOCK_ECC_LEN;
+	
+	
+	/*---- Public types ----*/
+	
+	// The modules in row-major order (false = light, true = dark).
+	public: using Modules = std::array<bool, static_cast<std::size_t>(SIZE * SIZE)>;
+	
+	public: using DataCodewords = std::array<std::uint8_t, static_cast<std::size_t>(NUM_DATA_CODEWORDS)>;
+	
+	private: using RawCodewords = std::array<std::uint8_t, static_cast<std::size_t>(NUM_RAW_CODEWORDS)>;
+	
+	
+	
+	/*---- Static factory functions ----*/
+	
+	/* 
+	 * Returns a QR Code representing the given segments in this format. The mask number is
+	 * either between 0 to 7 (inclusive) to force that mask, or -1 to automatically choose the
+	 * mask with the lowest penalty score. Throws data_too_long if the segments don't fit.
+	 */
+	public: static QrCodeFixed encodeSegments(const std::vector<QrSegment> &segs, int mask=-1) {
+		if (mask < -1 || mask > 7)
+			throw std::invalid_argument("Invalid value");
+		
+		int dataCapacityBits = NUM_DATA_CODEWORDS * 8;
+		int dataUsedBits = QrSegment::getTotalBits(segs, VERSION);
+		if (dataUsedBits == -1)
+			throw data_too_long("Segment too long");
+		if (dataUsedBits > dataCapacityBits) {
+			throw data_too_long("Data length = " + std::to_string(dataUsedBits) + " bits, "
+				+ "Max capacity = " + std::to_string(dataCapacityBits) + " bits");
+		}
+		
+		// Concatenate all segments to create the data bit string
+		BitBuffer bb;
+		bb.reserve(static_cast<std::size_t>(dataCapacityBits));
+		for (const QrSegment &seg : segs) {
+			bb.appendBits(static_cast<std::uint32_t>(seg.getMode().getModeBits()), 4);
+			bb.appendBits(static_cast<std::uint32_t>(seg.getNumChars()), seg.getMode().numCharCountBits(VERSION));
+			bb.insert(bb.end(), seg.getData().begin(), seg.getData().end());
+		}
+		
+		// Add terminator and pad up to a byte, then pack bits into bytes in big endian
+		bb.appendBits(0, std::min(4, dataCapacityBits - static_cast<int>(bb.size())));
+		bb.appendBits(0, (8 - static_cast<int>(bb.size() % 8)) % 8);
+		DataCodewords dataCodewords = {};
+		for (std::size_t i = 0; i < bb.size(); i++)
+			dataCodewords[i >> 3] |= static_cast<std::uint8_t>((bb[i] ? 1 : 0) << (7 - (i & 7)));
+		
+		// Pad with alternating bytes until data capacity is reached
+		std::uint8_t padByte = 0xEC;
+		for (std::size_t i = bb.size() / 8; i < dataCodewords.size(); i++, padByte ^= 0xEC ^ 0x11)
+			dataCodewords[i] = padByte;
+		return encodeCodewords(dataCodewords, mask);
+	}
+	
+	
+	/* 
+	 * Returns a QR Code representing the given text in this format, using the same single
+	 * numeric, alphanumeric or byte segment that QrSegment::makeSegments() would choose.
+	 * This is constexpr, so a code for a string known at compile time can be built entirely
+	 * by the compiler and stored in read-only data, for example:
+	 *     constexpr auto HELP_QR = QrCodeFixed<3, QrCode::Ecc::MEDIUM>::encodeText("https://...");
+	 * Text that doesn't fit throws data_too_long, which is a compile error in a constant expression.
+	 * Automatic masking scores all 8 masks during constant evaluation, which fits GCC's default
+	 * constexpr operation limit up to about version 12; for larger versions, force a mask
+	 * (or raise -fconstexpr-ops-limit). A forced mask works up to version 40.
+	 */
+	public: static constexpr QrCodeFixed encodeText(const char *text, int mask=-1) {
+		// Measure and classify the text in one pass
+		long len = 0;
+		int classes = QrSegment::CLASS_NUMERIC | QrSegment::CLASS_ALPHANUMERIC;
+		for (; text[len] != '\0'; len++)
+			classes &= QrSegment::CHARACTER_CLASSES[static_cast<std::uint8_t>(text[len])];
+		
+		// Mode indicator, character count field width and data length, as in QrSegment::Mode and its factories
+		const int charCountBits[3][3] = {{10, 12, 14}, {9, 11, 13}, {8, 16, 16}};  // Numeric, alphanumeric, byte
+		int mode = (classes & QrSegment::CLASS_NUMERIC) != 0 ? 0 : (classes & QrSegment::CLASS_ALPHANUMERIC) != 0 ? 1 : 2;
+		int ccBits = charCountBits[mode][(VERSION + 7) / 17];
+		long dataUsedBits = 0;
+		if (len > 0) {
+			if (len >= (1L << ccBits))
+				throw data_too_long("Segment too long");
+			switch (mode) {
+				case 0:  dataUsedBits = len / 3 * 10 + (len % 3 == 0 ? 0 : len % 3 * 3 + 1);  break;
+				case 1:  dataUsedBits = len / 2 * 11 + len % 2 * 6;  break;
+				default:  dataUsedBits = len * 8;  break;
+			}
+			dataUsedBits += 4 + ccBits;
+		}
+		int dataCapacityBits = NUM_DATA_CODEWORDS * 8;
+		if (dataUsedBits > dataCapacityBits)
+			throw data_too_long("Data too long for this version and error correction level");
+		
+		DataCodewords dataCodewords = {};
+		int bitLen = 0;
+		auto appendBits = [&dataCodewords, &bitLen](std::uint32_t val, int n) {
+			for (int i = n - 1; i >= 0; i--, bitLen++)
+				dataCodewords[static_cast<std::size_t>(bitLen >> 3)] |= static_cast<std::uint8_t>(((val >> i) & 1) << (7 - (bitLen & 7)));
+		};
+		if (len > 0) {
+			appendBits(mode == 0 ? 0x1 : mode == 1 ? 0x2 : 0x4, 4);
+			appendBits(static_cast<std::uint32_t>(len), ccBits);
+			for (long i = 0; i < len; ) {
+				int cls = QrSegment::CHARACTER_CLASSES[static_cast<std::uint8_t>(text[i])] & 0x3F;
+				if (mode == 0) {  // Groups of up to 3 digits
+					long n = std::min(len - i, 3L);
+					std::uint32_t accum = 0;
+					for (long j = 0; j < n; j++)
+						accum = accum * 10 + (QrSegment::CHARACTER_CLASSES[static_cast<std::uint8_t>(text[i + j])] & 0x3F);
+					appendBits(accum, static_cast<int>(n) * 3 + 1);
+					i += n;
+				} else if (mode == 1 && i + 1 < len) {  // Pairs of characters
+					appendBits(static_cast<std::uint32_t>(cls * 45 + (QrSegment::CHARACTER_CLASSES[static_cast<std::uint8_t>(text[i + 1])] & 0x3F)), 11);
+					i += 2;
+				} else if (mode == 1) {  // 1 character remaining
+					appendBits(static_cast<std::uint32_t>(cls), 6);
+					i++;
+				} else {
+					appendBits(static_cast<std::uint8_t>(text[i]), 8);
+					i++;
+				}
+			}
+		}
+		
+		// Add terminator and pad up to a byte (zero bits are already there)
+		bitLen += std::min(4, dataCapacityBits - bitLen);
+		bitLen += (8 - bitLen % 8) % 8;
+		
+		// Pad with alternating bytes until data capacity is reached
+		std::uint8_t padByte = 0xEC;
+		for (std::size_t i = static_cast<std::size_t>(bitLen / 8); i < dataCodewords.size(); i++, padByte ^= 0xEC ^ 0x11)
+			dataCodewords[i] = padByte;
+		return encodeCodewords(dataCodewords, mask);
+	}
+	
+	
+	/* 
+	 * Returns a QR Code with the given data codeword bytes (segment headers and
+	 * final padding included, error correction excluded) and mask number.
+	 * This works in constant expressions as well as at run time.
+	 */
+	public: static constexpr QrCodeFixed encodeCodewords(const DataCodewords &dataCodewords, int mask=-1) {
+		if (mask < -1 || mask > 7)
+			throw std::domain_error("Mask value out of range");
+		
+		// Compute ECC, draw modules on top of the function pattern template
+		Modules modules = FUNCTION_PATTERNS.modules;
+		const RawCodewords allCodewords = addEccAndInterleave(dataCodewords);
+		for (std::size_t i = 0; i < CODEWORD_POSITIONS.size(); i++)
+			modules[CODEWORD_POSITIONS[i]] = ((allCodewords[i >> 3] >> (7 - (i & 7))) & 1) != 0;
+		
+		// Do masking
+		if (mask == -1) {  // Automatically choose best mask
+			long minPenalty = LONG_MAX;
+			for (int i = 0; i < 8; i++) {
+				Modules candidate = modules;  // Cheaper than undoing the mask, also in constant evaluation
+				applyMask(candidate, i);
+				drawFormatBits(candidate, i);
+				long penalty = getPenaltyScore(candidate);
+				if (penalty < minPenalty) {
+					mask = i;
+					minPenalty = penalty;
+				}
+			}
+		}
+		applyMask(modules, mask);  // Apply the final choice of mask
+		drawFormatBits(modules, mask);  // Overwrite old format bits
+		return QrCodeFixed(modules, mask);
+	}
+	
+	
+	
+	/*---- Instance fields ----*/
+	
+	// The modules of this QR Code. Immutable after construction. Accessed through getModule().
+	private: Modules modules;
+	
+	// The index of the mask pattern used in this QR Code, which is between 0 and 7 (inclusive).
+	private: int mask;
+	
+	
+	
+	/*---- Constructor ----*/
+	
+	private: constexpr QrCodeFixed(const Modules &mods, int msk) :
+		modules(mods),
+		mask(msk) {}
+	
+	
+	
+	/*---- Public instance methods ----*/
+	
+	public: static constexpr int getVersion() {
+		return VERSION;
+	}
+	
+	
+	public: static constexpr int getSize() {
+		return SIZE;
+	}
+	
+	
+	public: static constexpr QrCode::Ecc getErrorCorrectionLevel() {
+		return ECL;
+	}
+	
+	
+	public: constexpr int getMask() const {
+		return mask;
+	}
+	
+	
+	/* 
+	 * Returns the color of the module (pixel) at the given coordinates, which is false
+	 * for light or true for dark. The top left corner has the coordinates (x=0, y=0).
+	 * If the given coordinates are out of bounds, then false (light) is returned.
+	 */
+	public: constexpr bool getModule(int x, int y) const {
+		return 0 <= x && x < SIZE && 0 <= y && y < SIZE && modules[static_cast<std::size_t>(y * SIZE + x)];
+	}
+	
+	
+	/* 
+	 * Returns all modules in row-major order.
+	 */
+	public: constexpr const Modules &getModules() const {
+		return modules;
+	}
+	
+	
+	
+	/*---- Private tables, computed at compile time ----*/
+	
+	// The function modules of this format, with the format bits drawn for mask 0.
+	private: struct FunctionPatterns {
+		Modules modules;
+		Modules isFunction;
+	};
+	private: static const FunctionPatterns FUNCTION_PATTERNS;
+	
+	// The module index of each codeword bit, in the zigzag order used by QrCode::drawCodewords().
+	private: static const std::array<std::uint16_t, static_cast<std::size_t>(NUM_RAW_CODEWORDS * 8)> CODEWORD_POSITIONS;
+	
+	// RS_PRODUCTS[i][x] is the product of coefficient i of the Reed-Solomon divisor and x.
+	private: static const std::array<std::array<std::uint8_t,256>, static_cast<std::size_t>(BLOCK_ECC_LEN)> RS_PRODUCTS;
+	
+	
+	private: static constexpr FunctionPatterns makeFunctionPatterns() {
+		FunctionPatterns result = {};
+		auto setFunctionModule = [&result](int x, int y, bool isDark) {
+			std::size_t i = static_cast<std::size_t>(y * SIZE + x);
+			result.modules[i] = isDark;
+			result.isFunction[i] = true;
+		};
+		
+		// Draw horizontal and vertical timing patterns
+		for (int i = 0; i < SIZE; i++) {
+			setFunctionModule(6, i, i % 2 == 0);
+			setFunctionModule(i, 6, i % 2 == 0);
+		}
+		
+		// Draw 3 finder patterns (all corners except bottom right; overwrites some timing modules)
+		const int finderCenters[3][2] = {{3, 3}, {SIZE - 4, 3}, {3, SIZE - 4}};
+		for (const auto &center : finderCenters) {
+			for (int dy = -4; dy <= 4; dy++) {
+				for (int dx = -4; dx <= 4; dx++) {
+					int dist = std::max(dx < 0 ? -dx : dx, dy < 0 ? -dy : dy);  // Chebyshev/infinity norm
+					int xx = center[0] + dx, yy = center[1] + dy;
+					if (0 <= xx && xx < SIZE && 0 <= yy && yy < SIZE)
+						setFunctionModule(xx, yy, dist != 2 && dist != 4);
+				}
+			}
+		}
+		
+		// Draw numerous alignment patterns, except on the three finder corners
+		if (VERSION > 1) {
+			constexpr int numAlign = VERSION / 7 + 2;
+			constexpr int step = (VERSION * 8 + numAlign * 3 + 5) / (numAlign * 4 - 4) * 2;
+			int alignPatPos[numAlign] = {};
+			alignPatPos[0] = 6;
+			for (int i = numAlign - 1, pos = SIZE - 7; i >= 1; i--, pos -= step)
+				alignPatPos[i] = pos;
+			for (int i = 0; i < numAlign; i++) {
+				for (int j = 0; j < numAlign; j++) {
+					if ((i == 0 && j == 0) || (i == 0 && j == numAlign - 1) || (i == numAlign - 1 && j == 0))
+						continue;
+					for (int dy = -2; dy <= 2; dy++) {
+						for (int dx = -2; dx <= 2; dx++) {
+							int dist = std::max(dx < 0 ? -dx : dx, dy < 0 ? -dy : dy);
+							setFunctionModule(alignPatPos[i] + dx, alignPatPos[j] + dy, dist != 1);
+						}
+					}
+				}
+			}
+		}
+		
+		// Mark the format bits as in drawFormatBits() and draw them with a dummy mask value
+		for (int i = 0; i <= 8; i++) {
+			if (i != 6) {  // Skip the timing modules
+				setFunctionModule(8, i, false);
+				setFunctionModule(i, 8, false);
+			}
+		}
+		for (int i = 0; i < 8; i++) {
+			setFunctionModule(SIZE - 1 - i, 8, false);
+			setFunctionModule(8, SIZE - 1 - i, false);
+		}
+		drawFormatBits(result.modules, 0);
+		
+		// Draw two copies of the version bits (with its own error correction code)
+		if (VERSION >= 7) {
+			int rem = VERSION;
+			for (int i = 0; i < 12; i++)
+				rem = (rem << 1) ^ ((rem >> 11) * 0x1F25);
+			long bits = static_cast<long>(VERSION) << 12 | rem;  // uint18
+			for (int i = 0; i < 18; i++) {
+				bool bit = ((bits >> i) & 1) != 0;
+				int a = SIZE - 11 + i % 3;
+				int b = i / 3;
+				setFunctionModule(a, b, bit);
+				setFunctionModule(b, a, bit);
+			}
+		}
+		return result;
+	}
+	
+	
+	private: static constexpr std::array<std::uint16_t, static_cast<std::size_t>(NUM_RAW_CODEWORDS * 8)> makeCodewordPositions() {
+		std::array<std::uint16_t, static_cast<std::size_t>(NUM_RAW_CODEWORDS * 8)> result = {};
+		const Modules &isFunction = FUNCTION_PATTERNS.isFunction;
+		std::size_t i = 0;  // Bit index into the data
+		// Do the funny zigzag scan
+		for (int right = SIZE - 1; right >= 1; right -= 2) {  // Index of right column in each column pair
+			if (right == 6)
+				right = 5;
+			for (int vert = 0; vert < SIZE; vert++) {  // Vertical counter
+				for (int j = 0; j < 2; j++) {
+					int x = right - j;  // Actual x coordinate
+					bool upward = ((right + 1) & 2) == 0;
+					int y = upward ? SIZE - 1 - vert : vert;  // Actual y coordinate
+					std::size_t index = static_cast<std::size_t>(y * SIZE + x);
+					if (!isFunction[index] && i < result.size()) {
+						result[i] = static_cast<std::uint16_t>(index);
+						i++;
+					}
+					// Any remainder bits (0 to 7) are left light before masking
+				}
+			}
+		}
+		return result;
+	}
+	
+	
+	private: static constexpr std::array<std::array<std::uint8_t,256>, static_cast<std::size_t>(BLOCK_ECC_LEN)> makeRsProducts() {
+		// Compute the divisor polynomial as in QrCode::reedSolomonComputeDivisor()
+		std::array<std::uint8_t, static_cast<std::size_t>(BLOCK_ECC_LEN)> divisor = {};
+		divisor[divisor.size() - 1] = 1;  // Start off with the monomial x^0
+		std::uint8_t root = 1;
+		for (int i = 0; i < BLOCK_ECC_LEN; i++) {
+			// Multiply the current product by (x - r^i)
+			for (std::size_t j = 0; j < divisor.size(); j++) {
+				divisor[j] = multiply(divisor[j], root);
+				if (j + 1 < divisor.size())
+					divisor[j] ^= divisor[j + 1];
+			}
+			root = multiply(root, 0x02);
+		}
+		
+		std::array<std::array<std::uint8_t,256>, static_cast<std::size_t>(BLOCK_ECC_LEN)> result = {};
+		for (std::size_t i = 0; i < result.size(); i++) {
+			for (int x = 0; x < 256; x++)
+				result[i][static_cast<std::size_t>(x)] = multiply(divisor[i], static_cast<std::uint8_t>(x));
+		}
+		return result;
+	}
+	
+	
+	/*---- Private helper functions ----*/
+	
+	// Returns the product of the two given field elements modulo GF(2^8/0x11D).
+	private: static constexpr std::uint8_t multiply(std::uint8_t x, std::uint8_t y) {
+		// Russian peasant multiplication
+		int z = 0;
+		for (int i = 7; i >= 0; i--) {
+			z = (z << 1) ^ ((z >> 7) * 0x11D);
+			z ^= ((y >> i) & 1) * x;
+		}
+		return static_cast<std::uint8_t>(z);
+	}
+	
+	
+	// Returns the data with the error correction codewords of every block appended, interleaved.
+	private: static constexpr RawCodewords addEccAndInterleave(const DataCodewords &data) {
+		RawCodewords result = {};
+		for (int j = 0, k = 0; j < NUM_BLOCKS; j++) {
+			int datLen = SHORT_DATA_LEN + (j < NUM_SHORT_BLOCKS ? 0 : 1);
+			
+			// Polynomial division of this block by the divisor
+			std::array<std::uint8_t, static_cast<std::size_t>(BLOCK_ECC_LEN)> rem = {};
+			for (int i = 0; i < datLen; i++) {
+				std::uint8_t b = data[static_cast<std::size_t>(k + i)];
+				std::uint8_t factor = b ^ rem[0];
+				for (std::size_t t = 0; t + 1 < rem.size(); t++)
+					rem[t] = rem[t + 1] ^ RS_PRODUCTS[t][factor];
+				rem[rem.size() - 1] = RS_PRODUCTS[rem.size() - 1][factor];
+				
+				// Data byte i of block j, skipping the padding position of short blocks
+				int pos = i < SHORT_DATA_LEN ? i * NUM_BLOCKS + j : SHORT_DATA_LEN * NUM_BLOCKS + j - NUM_SHORT_BLOCKS;
+				result[static_cast<std::size_t>(pos)] = b;
+			}
+			for (int i = 0; i < BLOCK_ECC_LEN; i++)
+				result[static_cast<std::size_t>(NUM_DATA_CODEWORDS + i * NUM_BLOCKS + j)] = rem[static_cast<std::size_t>(i)];
+			k += datLen;
+		}
+		return result;
+	}
+	
+	
+	// Draws two copies of the format bits (with its own error correction code) for the given mask.
+	private: static constexpr void drawFormatBits(Modules &modules, int msk) {
+		int formatBits = 0;
+		switch (ECL) {
+			case QrCode::Ecc::LOW     :  formatBits = 1;  break;
+			case QrCode::Ecc::MEDIUM  :  formatBits = 0;  break;
+			case QrCode::Ecc::QUARTILE:  formatBits = 3;  break;
+			case QrCode::Ecc::HIGH    :  formatBits = 2;  break;
+		}
+		int data = formatBits << 3 | msk;
+		int rem = data;
+		for (int i = 0; i < 10; i++)
+			rem = (rem << 1) ^ ((rem >> 9) * 0x537);
+		int bits = (data << 10 | rem) ^ 0x5412;  // uint15
+		auto set = [&modules](int x, int y, bool isDark) {
+			modules[static_cast<std::size_t>(y * SIZE + x)] = isDark;
+		};
+		auto bit = [bits](int i) {
+			return ((bits >> i) & 1) != 0;
+		};
+		
+		// Draw first copy
+		for (int i = 0; i <= 5; i++)
+			set(8, i, bit(i));
+		set(8, 7, bit(6));
+		set(8, 8, bit(7));
+		set(7, 8, bit(8));
+		for (int i = 9; i < 15; i++)
+			set(14 - i, 8, bit(i));
+		
+		// Draw second copy
+		for (int i = 0; i < 8; i++)
+			set(SIZE - 1 - i, 8, bit(i));
+		for (int i = 8; i < 15; i++)
+			set(8, SIZE - 15 + i, bit(i));
+		set(8, SIZE - 8, true);  // Always dark
+	}
+	
+	
+	// XORs the non-function modules with the given mask pattern. Applying the same mask twice undoes it.
+	private: static constexpr void applyMask(Modules &modules, int msk) {
+		const Modules &isFunction = FUNCTION_PATTERNS.isFunction;
+		for (int y = 0; y < SIZE; y++) {
+			for (int x = 0; x < SIZE; x++) {
+				bool invert = false;
+				switch (msk) {
+					case 0:  invert = (x + y) % 2 == 0;                    break;
+					case 1:  invert = y % 2 == 0;                          break;
+					case 2:  invert = x % 3 == 0;                          break;
+					case 3:  invert = (x + y) % 3 == 0;                    break;
+					case 4:  invert = (x / 3 + y / 2) % 2 == 0;            break;
+					case 5:  invert = x * y % 2 + x * y % 3 == 0;          break;
+					case 6:  invert = (x * y % 2 + x * y % 3) % 2 == 0;    break;
+					case 7:  invert = ((x + y) % 2 + x * y % 3) % 2 == 0;  break;
+				}
+				std::size_t i = static_cast<std::size_t>(y * SIZE + x);
+				modules[i] = modules[i] ^ (invert && !isFunction[i]);
+			}
+		}
+	}
+	
+	
+	// Calculates the penalty score of the given modules, exactly as QrCode::getPenaltyScore() does.
+	private: static constexpr long getPenaltyScore(const Modules &modules) {
+		long result = 0;
+		int dark = 0;
+		
+		// Adjacent modules in row/column having same color, and finder-like patterns
+		for (int pass = 0; pass < 2; pass++) {
+			for (int a = 0; a < SIZE; a++) {
+				bool runColor = false;
+				int run = 0;
+				std::array<int,7> runHistory = {};
+				for (int b = 0; b < SIZE; b++) {
+					bool color = modules[static_cast<std::size_t>(pass == 0 ? a * SIZE + b : b * SIZE + a)];
+					if (color && pass == 0)
+						dark++;
+					if (color == runColor) {
+						run++;
+						if (run == 5)
+							result += PENALTY_N1;
+						else if (run > 5)
+							result++;
+					} else {
+						finderPenaltyAddHistory(run, runHistory);
+						if (!runColor)
+							result += finderPenaltyCountPatterns(runHistory) * PENALTY_N3;
+						runColor = color;
+						run = 1;
+					}
+				}
+				result += finderPenaltyTerminateAndCount(runColor, run, runHistory) * PENALTY_N3;
+			}
+		}
+		
+		// 2*2 blocks of modules having same color
+		for (int y = 0; y < SIZE - 1; y++) {
+			for (int x = 0; x < SIZE - 1; x++) {
+				std::size_t i = static_cast<std::size_t>(y * SIZE + x);
+				bool color = modules[i];
+				if (color == modules[i + 1] && color == modules[i + SIZE] && color == modules[i + SIZE + 1])
+					result += PENALTY_N2;
+			}
+		}
+		
+		// Balance of dark and light modules (counted during the row pass)
+		constexpr int total = SIZE * SIZE;  // Note that size is odd, so dark/total != 1/2
+		// Compute the smallest integer k >= 0 such that (45-5k)% <= dark/total <= (55+5k)%
+		long diff = dark * 20L - total * 10L;
+		int k = static_cast<int>(((diff < 0 ? -diff : diff) + total - 1) / total) - 1;
+		result += k * PENALTY_N4;
+		return result;
+	}
+	
+	
+	// Can only be called immediately after a light run is added, and returns either 0, 1, or 2.
+	private: static constexpr int finderPenaltyCountPatterns(const std::array<int,7> &runHistory) {
+		int n = runHistory[1];
+		bool core = n > 0 && runHistory[2] == n && runHistory[3] == n * 3 && runHistory[4] == n && runHistory[5] == n;
+		return (core && runHistory[0] >= n * 4 && runHistory[6] >= n ? 1 : 0)
+		     + (core && runHistory[6] >= n * 4 && runHistory[0] >= n ? 1 : 0);
+	}
+	
+	
+	// Must be called at the end of a line (row or column) of modules.
+	private: static constexpr int finderPenaltyTerminateAndCount(bool currentRunColor, int currentRunLength, std::array<int,7> &runHistory) {
+		if (currentRunColor) {  // Terminate dark run
+			finderPenaltyAddHistory(currentRunLength, runHistory);
+			currentRunLength = 0;
+		}
+		currentRunLength += SIZE;  // Add light border to final run
+		finderPenaltyAddHistory(currentRunLength, runHistory);
+		return finderPenaltyCountPatterns(runHistory);
+	}
+	
+	
+	// Pushes the given value to the front and drops the last value.
+	private: static constexpr void finderPenaltyAddHistory(int currentRunLength, std::array<int,7> &runHistory) {
+		if (runHistory[0] == 0)
+			currentRunLength += SIZE;  // Add light border to initial run
+		runHistory = {currentRunLength, runHistory[0], runHistory[1], runHistory[2], runHistory[3], runHistory[4], runHistory[5]};
+	}
+	
+	
+	// Same values as QrCode::PENALTY_N1 to N4.
+	private: static constexpr int PENALTY_N1 =  3;
+	private: static constexpr int PENALTY_N2 =  3;
+	private: static constexpr int PENALTY_N3 = 40;
+	private: static constexpr int PENALTY_N4 = 10;
+	
+};
+
+
+template <int VERSION, QrCode::Ecc ECL>
+constexpr typename QrCodeFixed<VERSION, ECL>::FunctionPatterns QrCodeFixed<VERSION, ECL>::FUNCTION_PATTERNS
+	= QrCodeFixed<VERSION, ECL>::makeFunctionPatterns();
+
+template <int VERSION, QrCode::Ecc ECL>
+constexpr std::array<std::uint16_t, static_cast<std::size_t>(QrCodeFixed<VERSION, ECL>::NUM_RAW_CODEWORDS * 8)> QrCodeFixed<VERSION, ECL>::CODEWORD_POSITIONS
+	= QrCodeFixed<VERSION, ECL>::makeCodewordPositions();
+
+template <int VERSION, QrCode::Ecc ECL>
+constexpr std::array<std::array<std::uint8_t,256>, static_cast<std::size_t>(QrCodeFixed<VERSION, ECL>::BLOCK_ECC_LEN)> QrCodeFixed<VERSION, ECL>::RS_PRODUCTS
+	= QrCodeFixed<VERSION, ECL>::makeRsProducts();
+
+}
@@ -0,0 +1,243 @@
+#include "qrcost.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace qrcost {
+
+namespace {
+
+using qrcodegen::QrCode;
+using qrcodegen::QrSegment;
+
+struct Coefficient {
+    const char*        name;
+    double CostModel::* member;
+};
+
+constexpr Coefficient coefficients[] = {
+    {"fixed-ns",                      &CostModel::fixedNs},
+    {"segment-ns-per-byte",           &CostModel::segmentNsPerByte},
+    {"build-ns-per-module",           &CostModel::buildNsPerModule},
+    {"mask-ns-per-module",            &CostModel::maskNsPerModule},
+    {"raster-ns-per-pixel",           &CostModel::rasterNsPerPixel},
+    {"compress-ns-per-scaled-module", &CostModel::compressNsPerScaledModule},
+    {"compress-ns-per-scaled-pixel",  &CostModel::compressNsPerScaledPixel},
+    {"png-fixed-bytes",               &CostModel::pngFixedBytes},
+    {"png-bytes-per-module",          &CostModel::pngBytesPerModule},
+    {"png-bytes-per-pixel",           &CostModel::pngBytesPerPixel},
+};
+
+constexpr QrCode::Ecc boostLevels[] = {QrCode::Ecc::MEDIUM, QrCode::Ecc::QUARTILE, QrCode::Ecc::HIGH};
+
+// Least-squares fit of y = c[0] + c[1] * x[1] + ... + c[k] * x[k], with x[0] = 1 in every row.
+// Solves the normal equations by Gaussian elimination, which is plenty for two regressors.
+template <std::size_t N>
+[[nodiscard]]
+std::array<double, N> fitLinear(const std::vector<std::array<double, N>>& xs, const std::vector<double>& ys) {
+    std::array<std::array<double, N + 1>, N> system{};
+    for (std::size_t r = 0; r < xs.size(); ++r) {
+        for (std::size_t i = 0; i < N; ++i) {
+            for (std::size_t j = 0; j < N; ++j) {
+                system[i][j] += xs[r][i] * xs[r][j];
+            }
+            system[i][N] += xs[r][i] * ys[r];
+        }
+    }
+    for (std::size_t i = 0; i < N; ++i) {
+        std::size_t pivot = i;
+        for (std::size_t r = i + 1; r < N; ++r) {
+            if (std::abs(system[r][i]) > std::abs(system[pivot][i])) {
+                pivot = r;
+            }
+        }
+        std::swap(system[i], system[pivot]);
+        if (system[i][i] == 0) {
+            throw std::invalid_argument("Samples do not determine the cost model");
+        }
+        for (std::size_t r = 0; r < N; ++r) {
+            const double factor = system[r][i] / system[i][i];
+            for (std::size_t c = i; r != i && c <= N; ++c) {
+                system[r][c] -= factor * system[i][c];
+            }
+        }
+    }
+    std::array<double, N> result;
+    for (std::size_t i = 0; i < N; ++i) {
+        result[i] = system[i][N] / system[i][i];
+    }
+    return result;
+}
+
+// Bits of one segment of `chars` characters in the given mode, header included.
+[[nodiscard]]
+int segmentBits(std::size_t chars, const QrSegment::Mode& mode, int version) noexcept {
+    const int n = static_cast<int>(chars);
+    int data;
+    switch (mode.getModeBits()) {
+        case 0x1:  data = n / 3 * 10 + (n % 3 == 2 ? 7 : n % 3 == 1 ? 4 : 0);  break;
+        case 0x2:  data = n / 2 * 11 + (n % 2) * 6;  break;
+        case 0x8:  data = n * 13;  break;
+        default:   data = n * 8;  break;
+    }
+    return 4 + mode.numCharCountBits(version) + data;
+}
+
+} // namespace
+
+CostModel CostModel::load(const std::filesystem::path& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Cannot read " + path.string());
+    }
+    CostModel model;
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+        std::istringstream fields(line);
+        std::string name;
+        if (!(fields >> name) || name[0] == '#') {
+            continue;
+        }
+        const auto found = std::find_if(std::begin(coefficients), std::end(coefficients),
+            [&](const Coefficient& c) { return name == c.name; });
+        double value;
+        std::string rest;
+        if (found == std::end(coefficients) || !(fields >> value) || (fields >> rest)) {
+            throw std::runtime_error(path.string() + ":" + std::to_string(lineNumber) + ": malformed line");
+        }
+        model.*(found->member) = value;
+    }
+    return model;
+}
+
+void CostModel::save(const std::filesystem::path& path) const {
+    std::ofstream out(path);
+    out << "# qrtool bench-cost model\n";
+    for (const auto& c : coefficients) {
+        out << c.name << ' ' << this->*(c.member) << '\n';
+    }
+    if (!out.flush()) {
+        throw std::runtime_error("Cannot write " + path.string());
+    }
+}
+
+CostModel calibrate(const std::vector<Sample>& samples) {
+    if (samples.size() < 3) {
+        throw std::invalid_argument("Too few samples to calibrate");
+    }
+    std::vector<std::array<double, 2>> bytes, modules, pixels;
+    std::vector<std::array<double, 3>> compressDrivers, pngDrivers;
+    std::vector<double> segment, build, mask, raster, compress, png;
+    for (const auto& s : samples) {
+        const double size = s.version * 4 + 17;
+        const double side = (size + s.border * 2) * s.scale;
+        bytes.push_back({1, static_cast<double>(s.payloadBytes)});
+        modules.push_back({1, size * size});
+        pixels.push_back({1, side * side});
+        compressDrivers.push_back({1, size * size * s.scale, side * side * s.scale});
+        pngDrivers.push_back({1, size * size, side * side});
+        segment.push_back(s.segmentNs);
+        build.push_back(s.buildNs);
+        mask.push_back(s.maskNs);
+        raster.push_back(s.rasterNs);
+        compress.push_back(s.compressNs);
+        png.push_back(static_cast<double>(s.pngBytes));
+    }
+
+    CostModel model;
+    const auto segmentFit  = fitLinear(bytes, segment);
+    const auto buildFit    = fitLinear(modules, build);
+    const auto maskFit     = fitLinear(modules, mask);
+    const auto rasterFit   = fitLinear(pixels, raster);
+    const auto compressFit = fitLinear(compressDrivers, compress);
+    const auto pngFit      = fitLinear(pngDrivers, png);
+    model.fixedNs = std::max(segmentFit[0] + buildFit[0] + maskFit[0] + rasterFit[0] + compressFit[0], 0.0);
+    model.segmentNsPerByte          = std::max(segmentFit[1], 0.0);
+    model.buildNsPerModule          = std::max(buildFit[1], 0.0);
+    model.maskNsPerModule           = std::max(maskFit[1], 0.0);
+    model.rasterNsPerPixel          = std::max(rasterFit[1], 0.0);
+    model.compressNsPerScaledModule = std::max(compressFit[1], 0.0);
+    model.compressNsPerScaledPixel  = std::max(compressFit[2], 0.0);
+    model.pngFixedBytes             = std::max(pngFit[0], 0.0);
+    model.pngBytesPerModule         = std::max(pngFit[1], 0.0);
+    model.pngBytesPerPixel          = std::max(pngFit[2], 0.0);
+    return model;
+}
+
+Estimate Estimator::estimate(std::size_t chars, const QrSegment::Mode& mode, QrCode::Ecc ecc,
+                             int scale, int border) const {
+    Estimate result;
+    // Character capacity grows with the version, so the smallest version that holds the
+    // payload is found by bisecting the table
+    int lo = QrCode::MIN_VERSION, hi = QrCode::MAX_VERSION;
+    if (chars > static_cast<std::size_t>(QrCode::getMaxPayload(hi, ecc, mode))) {
+        return result;
+    }
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (chars <= static_cast<std::size_t>(QrCode::getMaxPayload(mid, ecc, mode))) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    result.fits    = true;
+    result.version = lo;
+    result.ecc     = ecc;
+    for (const QrCode::Ecc level : boostLevels) {
+        if (chars <= static_cast<std::size_t>(QrCode::getMaxPayload(lo, level, mode))) {
+            result.ecc = level;
+        }
+    }
+    result.dataBits = segmentBits(chars, mode, lo);
+    addCosts(result, mode.getModeBits() == 0x8 ? chars * 2 : chars, scale, border);
+    return result;
+}
+
+Estimate Estimator::estimate(const std::string& text, QrCode::Ecc ecc, int scale, int border) const {
+    if (text.empty()) {
+        return estimate(std::vector<QrSegment>{}, ecc, scale, border);  // No segment at all
+    }
+    const QrSegment::Mode& mode = QrSegment::isNumeric(text.c_str()) ? QrSegment::Mode::NUMERIC
+        : QrSegment::isAlphanumeric(text.c_str()) ? QrSegment::Mode::ALPHANUMERIC : QrSegment::Mode::BYTE;
+    return estimate(text.length(), mode, ecc, scale, border);
+}
+
+Estimate Estimator::estimate(const std::vector<QrSegment>& segs, QrCode::Ecc ecc, int scale, int border) const {
+    Estimate result;
+    const int version = QrCode::getMinVersion(segs, ecc);
+    if (version == -1) {
+        return result;
+    }
+    result.fits    = true;
+    result.version = version;
+    result.ecc     = ecc;
+    for (const QrCode::Ecc level : boostLevels) {
+        if (QrCode::getMinVersion(segs, level, version, version) == version) {
+            result.ecc = level;
+        }
+    }
+    result.dataBits = QrSegment::getTotalBits(segs, version);
+    addCosts(result, static_cast<std::size_t>(result.dataBits) / 8, scale, border);
+    return result;
+}
+
+void Estimator::addCosts(Estimate& result, std::size_t payloadBytes, int scale, int border) const noexcept {
+    result.size      = result.version * 4 + 17;
+    result.imageSide = static_cast<unsigned>((result.size + border * 2) * scale);
+    const double modules = static_cast<double>(result.size) * result.size;
+    const double pixels  = static_cast<double>(result.imageSide) * result.imageSide;
+    result.encodeNs   = model_.fixedNs + model_.segmentNsPerByte * static_cast<double>(payloadBytes)
+                      + (model_.buildNsPerModule + model_.maskNsPerModule) * modules;
+    result.rasterNs   = model_.rasterNsPerPixel * pixels;
+    result.compressNs = (model_.compressNsPerScaledModule * modules + model_.compressNsPerScaledPixel * pixels) * scale;
+    result.pngBytes   = static_cast<std::size_t>(model_.pngFixedBytes + model_.pngBytesPerModule * modules
+                                                 + model_.pngBytesPerPixel * pixels);
+}
+
+} // namespace qrcost
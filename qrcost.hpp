@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "qrcodegen.hpp"
+
+// Predicts what encoding a payload will produce and cost before doing it: the version and
+// boosted error correction level, the image size, the PNG size and the CPU time. The version
+// comes from the capacity tables of QrCode::getMaxPayload, so an estimate takes nanoseconds;
+// times and sizes come from a per-stage linear model calibrated with `qrtool bench-cost`.
+namespace qrcost {
+
+// Cost of each stage of encoding one code and writing it as a 1-bit greyscale PNG, as a fixed
+// part plus parts proportional to the quantities that drive the stage. Deflate searches longer
+// match chains in the runs a larger scale makes, so its time grows with the scale on top of
+// the pixel count. The defaults were calibrated on an x86-64 build with -O2.
+struct CostModel {
+    double fixedNs                   = 200000;   // Per code, summed over the stages
+    double segmentNsPerByte          = 68;       // Segmentation and data codewords, per payload byte
+    double buildNsPerModule          = 16;       // Function patterns, ECC and placement with a fixed mask
+    double maskNsPerModule           = 580;      // Drawing and scoring the eight mask candidates
+    double rasterNsPerPixel          = 0.85;
+    double compressNsPerScaledModule = 9.7;      // Per module times the scale
+    double compressNsPerScaledPixel  = 6.6;      // Per pixel times the scale
+    double pngFixedBytes             = 165;
+    double pngBytesPerModule         = 0.14;
+    double pngBytesPerPixel          = 0.003;
+
+    // Reads a model written by save(). Names not present keep their defaults. Throws
+    // std::runtime_error if the file cannot be read or has a malformed or unknown line.
+    [[nodiscard]]
+    static CostModel load(const std::filesystem::path& path);
+
+    // Writes one "name value" line per coefficient. Throws std::runtime_error on failure.
+    void save(const std::filesystem::path& path) const;
+};
+
+// One measured encode, as collected by the benchmark that calibrates a CostModel.
+struct Sample {
+    int         version      = 0;
+    int         scale        = 0;
+    int         border       = 0;
+    std::size_t payloadBytes = 0;
+    double      segmentNs    = 0;
+    double      buildNs      = 0;    // Constructor with a fixed mask
+    double      maskNs       = 0;    // Constructor choosing the mask, less buildNs
+    double      rasterNs     = 0;
+    double      compressNs   = 0;
+    std::size_t pngBytes     = 0;
+};
+
+// Fits every coefficient by least squares over the samples, which should span many versions
+// and at least two scales. Throws std::invalid_argument for fewer than three samples or
+// samples that do not vary enough to separate the terms.
+[[nodiscard]]
+CostModel calibrate(const std::vector<Sample>& samples);
+
+struct Estimate {
+    bool                   fits      = false;   // Everything below is zero when false
+    int                    version   = 0;
+    qrcodegen::QrCode::Ecc ecc       = qrcodegen::QrCode::Ecc::LOW;   // After boosting
+    int                    size      = 0;       // Modules per side
+    unsigned               imageSide = 0;       // Pixels per side, border included
+    int                    dataBits  = 0;       // Segment headers and data, before padding
+    std::size_t            pngBytes  = 0;
+    double                 encodeNs   = 0;      // Segmentation, ECC and masking
+    double                 rasterNs   = 0;
+    double                 compressNs = 0;
+
+    [[nodiscard]]
+    double totalNs() const noexcept { return encodeNs + rasterNs + compressNs; }
+};
+
+// Answers estimates for encodeSegments with its defaults (all versions, automatic mask,
+// boostEcl) followed by qrexport::renderGreyscale and encodeGreyscalePng.
+class Estimator final {
+public:
+    explicit Estimator(CostModel model = {}) noexcept
+        : model_{model} {}
+
+    // For a single segment of the given mode holding `chars` characters, from the tables alone.
+    // Throws std::invalid_argument for ECI mode.
+    [[nodiscard]]
+    Estimate estimate(std::size_t chars, const qrcodegen::QrSegment::Mode& mode, qrcodegen::QrCode::Ecc ecc,
+                      int scale = 4, int border = 4) const;
+
+    // For UTF-8 text segmented as QrSegment::makeSegments would, i.e. as encodeText encodes it.
+    [[nodiscard]]
+    Estimate estimate(const std::string& text, qrcodegen::QrCode::Ecc ecc, int scale = 4, int border = 4) const;
+
+    // For ready-made segments, such as ECI-prefixed legacy text.
+    [[nodiscard]]
+    Estimate estimate(const std::vector<qrcodegen::QrSegment>& segs, qrcodegen::QrCode::Ecc ecc,
+                      int scale = 4, int border = 4) const;
+
+    [[nodiscard]]
+    const CostModel& model() const noexcept { return model_; }
+
+private:
+    CostModel model_;
+
+    // Fills in the sizes and times once the version, level and data bits are known.
+    void addCosts(Estimate& result, std::size_t payloadBytes, int scale, int border) const noexcept;
+};
+
+} // namespace qrcost
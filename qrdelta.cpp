@@ -0,0 +1,282 @@
+#include "qrdelta.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+namespace qrdelta {
+
+namespace {
+
+constexpr unsigned char magic[] = {'Q', 'R', 'D', 0x01};
+constexpr std::size_t headerSize = sizeof(magic) + 8 + 8;
+
+// Matches are found through 4-byte windows of the base; shorter copies than this cost more
+// (tag plus offset varints) than inserting the bytes.
+constexpr std::size_t windowSize  = 4;
+constexpr std::size_t minCopySize = 8;
+constexpr std::size_t maxCandidates = 64;
+
+void putU64(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<std::uint8_t>(value >> shift));
+    }
+}
+
+[[nodiscard]]
+std::uint64_t getU64(const std::vector<std::uint8_t>& in, std::size_t pos) noexcept {
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < 8; ++i) {
+        value = (value << 8) | in[pos + i];
+    }
+    return value;
+}
+
+void putVarint(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+[[nodiscard]]
+std::uint64_t getVarint(const std::vector<std::uint8_t>& in, std::size_t& pos) {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= in.size()) {
+            throw std::runtime_error("Truncated delta");
+        }
+        const std::uint8_t byte = in[pos++];
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Invalid varint in delta");
+}
+
+[[nodiscard]]
+std::uint32_t windowKey(const std::string& text, std::size_t pos) noexcept {
+    std::uint32_t key = 0;
+    for (std::size_t i = 0; i < windowSize; ++i) {
+        key = (key << 8) | static_cast<unsigned char>(text[pos + i]);
+    }
+    return key;
+}
+
+void flushInsert(std::vector<std::uint8_t>& out, const std::string& target, std::size_t start, std::size_t end) {
+    if (end > start) {
+        putVarint(out, static_cast<std::uint64_t>(end - start) << 1);
+        out.insert(out.end(), target.begin() + static_cast<std::ptrdiff_t>(start),
+                   target.begin() + static_cast<std::ptrdiff_t>(end));
+    }
+}
+
+[[nodiscard]]
+std::string readText(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+std::uint64_t contentHash(const std::string& text) noexcept {
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+    for (const char c : text) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+std::vector<std::uint8_t> makeDelta(const std::string& base, const std::string& target) {
+    std::vector<std::uint8_t> out(std::begin(magic), std::end(magic));
+    putU64(out, contentHash(base));
+    putU64(out, contentHash(target));
+
+    // Positions of every base window, later positions last
+    std::unordered_map<std::uint32_t, std::vector<std::size_t>> index;
+    if (base.size() >= windowSize) {
+        index.reserve(base.size());
+        for (std::size_t pos = 0; pos + windowSize <= base.size(); ++pos) {
+            index[windowKey(base, pos)].push_back(pos);
+        }
+    }
+
+    // Greedy: take the longest copy starting at each target position, else keep the byte as literal
+    std::size_t insertStart = 0;
+    std::size_t pos = 0;
+    while (pos < target.size()) {
+        std::size_t bestLength = 0, bestOffset = 0;
+        if (pos + windowSize <= target.size()) {
+            const auto found = index.find(windowKey(target, pos));
+            if (found != index.end()) {
+                const auto& candidates = found->second;
+                const std::size_t first = candidates.size() > maxCandidates ? candidates.size() - maxCandidates : 0;
+                for (std::size_t i = first; i < candidates.size(); ++i) {
+                    const std::size_t offset = candidates[i];
+                    std::size_t length = 0;
+                    while (offset + length < base.size() && pos + length < target.size()
+                           && base[offset + length] == target[pos + length]) {
+                        ++length;
+                    }
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestOffset = offset;
+                    }
+                }
+            }
+        }
+
+        if (bestLength >= minCopySize) {
+            flushInsert(out, target, insertStart, pos);
+            putVarint(out, (static_cast<std::uint64_t>(bestLength) << 1) | 1);
+            putVarint(out, bestOffset);
+            pos += bestLength;
+            insertStart = pos;
+        } else {
+            ++pos;
+        }
+    }
+    flushInsert(out, target, insertStart, target.size());
+    return out;
+}
+
+bool isDelta(const std::vector<std::uint8_t>& payload) noexcept {
+    return payload.size() >= headerSize && std::equal(std::begin(magic), std::end(magic), payload.begin());
+}
+
+std::uint64_t baseHash(const std::vector<std::uint8_t>& payload) noexcept {
+    return getU64(payload, sizeof(magic));
+}
+
+std::string applyDelta(const std::string& base, const std::vector<std::uint8_t>& payload) {
+    if (!isDelta(payload)) {
+        throw std::runtime_error("Not a delta payload");
+    }
+    if (contentHash(base) != baseHash(payload)) {
+        throw std::runtime_error("Delta was made against a different base revision");
+    }
+
+    std::string target;
+    std::size_t pos = headerSize;
+    while (pos < payload.size()) {
+        const std::uint64_t tag = getVarint(payload, pos);
+        const std::uint64_t length = tag >> 1;
+        if ((tag & 1) != 0) {
+            const std::uint64_t offset = getVarint(payload, pos);
+            if (offset > base.size() || length > base.size() - offset) {
+                throw std::runtime_error("Delta copies outside the base revision");
+            }
+            target.append(base, static_cast<std::size_t>(offset), static_cast<std::size_t>(length));
+        } else {
+            if (length > payload.size() - pos) {
+                throw std::runtime_error("Truncated delta");
+            }
+            target.append(reinterpret_cast<const char*>(payload.data() + pos), static_cast<std::size_t>(length));
+            pos += static_cast<std::size_t>(length);
+        }
+    }
+
+    if (contentHash(target) != getU64(payload, sizeof(magic) + 8)) {
+        throw std::runtime_error("Delta result does not match its hash");
+    }
+    return target;
+}
+
+History::History(std::filesystem::path directory, std::size_t capacity)
+    : directory_{std::move(directory)}
+    , capacity_{std::max<std::size_t>(capacity, 1)} {}
+
+std::filesystem::path History::defaultDirectory() {
+    std::error_code ec;
+    std::filesystem::path temp = std::filesystem::temp_directory_path(ec);
+    if (ec) {
+        temp = ".";
+    }
+    return temp / "QRTextFetch-history";
+}
+
+bool History::store(const std::string& text) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) {
+        return false;
+    }
+
+    const std::filesystem::path path = pathFor(contentHash(text));
+    if (std::filesystem::exists(path, ec)) {
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+    } else {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        if (!out) {
+            return false;
+        }
+    }
+
+    const auto stored = revisions();
+    for (std::size_t i = capacity_; i < stored.size(); ++i) {
+        std::filesystem::remove(stored[i], ec);
+    }
+    return true;
+}
+
+bool History::load(std::uint64_t hash, std::string& text) const {
+    const std::filesystem::path path = pathFor(hash);
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        return false;
+    }
+    text = readText(path);
+    // Guards against a truncated or edited file
+    return contentHash(text) == hash;
+}
+
+std::vector<std::uint8_t> History::bestDelta(const std::string& target) const {
+    std::vector<std::uint8_t> best;
+    for (const auto& path : revisions()) {
+        const std::string base = readText(path);
+        if (base == target) {
+            // Resending an identical revision: the delta is just its header
+            return makeDelta(base, target);
+        }
+        std::vector<std::uint8_t> delta = makeDelta(base, target);
+        if (delta.size() < target.size() && (best.empty() || delta.size() < best.size())) {
+            best = std::move(delta);
+        }
+    }
+    return best;
+}
+
+std::filesystem::path History::pathFor(std::uint64_t hash) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.txt", static_cast<unsigned long long>(hash));
+    return directory_ / name;
+}
+
+std::vector<std::filesystem::path> History::revisions() const {
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> files;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(directory_, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() == ".txt" && it->is_regular_file(ec)) {
+            files.emplace_back(it->last_write_time(ec), it->path());
+        }
+    }
+    std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<std::filesystem::path> paths;
+    paths.reserve(files.size());
+    for (auto& file : files) {
+        paths.push_back(std::move(file.second));
+    }
+    return paths;
+}
+
+} // namespace qrdelta
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Delta transfer: when a text is sent again with small edits, only a binary diff against
+// an earlier revision is encoded. Both sides keep the revisions they have sent or received
+// in a History, keyed by content hash, so the diff names its base by hash alone.
+//
+// Payload layout: "QRD" 0x01, the 64-bit FNV-1a hashes of the base and of the result (big
+// endian), then operations until the end. Each operation starts with a varint
+// (length << 1 | isCopy); a copy continues with a varint offset into the base, an insert
+// with `length` literal bytes.
+namespace qrdelta {
+
+// 64-bit FNV-1a hash of the text, used as the revision key.
+[[nodiscard]]
+std::uint64_t contentHash(const std::string& text) noexcept;
+
+// Builds the diff that turns base into target.
+[[nodiscard]]
+std::vector<std::uint8_t> makeDelta(const std::string& base, const std::string& target);
+
+// Whether a payload has the delta layout.
+[[nodiscard]]
+bool isDelta(const std::vector<std::uint8_t>& payload) noexcept;
+
+// Returns the base hash named by a delta payload, which must satisfy isDelta.
+[[nodiscard]]
+std::uint64_t baseHash(const std::vector<std::uint8_t>& payload) noexcept;
+
+// Rebuilds the target from its base. Throws std::runtime_error if the payload is malformed,
+// if base is not the revision it names, or if the result does not hash to the target hash.
+[[nodiscard]]
+std::string applyDelta(const std::string& base, const std::vector<std::uint8_t>& payload);
+
+// Revisions stored as <hash>.txt files in one directory, most recently stored first.
+// Storing beyond the capacity deletes the oldest. File system errors are not fatal:
+// a failed store returns false and a missing revision simply cannot serve as a base.
+class History final {
+public:
+    explicit History(std::filesystem::path directory, std::size_t capacity = 32);
+
+    // A directory under the system temporary directory, shared by the GUI and qrtool.
+    [[nodiscard]]
+    static std::filesystem::path defaultDirectory();
+
+    // Stores a revision, or marks an existing one as the most recent.
+    bool store(const std::string& text);
+
+    [[nodiscard]]
+    bool load(std::uint64_t hash, std::string& text) const;
+
+    // Returns the smallest delta from any stored revision to target, or an empty vector
+    // if no revision gives a delta smaller than target itself.
+    [[nodiscard]]
+    std::vector<std::uint8_t> bestDelta(const std::string& target) const;
+
+private:
+    std::filesystem::path directory_;
+    std::size_t           capacity_;
+
+    [[nodiscard]]
+    std::filesystem::path pathFor(std::uint64_t hash) const;
+
+    // Stored revision files, most recent first.
+    [[nodiscard]]
+    std::vector<std::filesystem::path> revisions() const;
+};
+
+} // namespace qrdelta
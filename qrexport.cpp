@@ -0,0 +1,909 @@
+#include "qrexport.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "lodepng.h"
+
+namespace qrexport {
+
+namespace {
+
+[[nodiscard]]
+std::vector<unsigned char> encodeRaw(const std::vector<unsigned char>& image, int imgSize,
+                                     LodePNGColorType colorType) {
+    std::vector<unsigned char> pngData;
+    const unsigned error = lodepng::encode(
+        pngData,
+        image,
+        static_cast<unsigned>(imgSize),
+        static_cast<unsigned>(imgSize),
+        colorType
+    );
+
+    if (error != 0u) {
+        return {};
+    }
+    return pngData;
+}
+
+void putU32(unsigned char* p, std::uint32_t value) noexcept {
+    p[0] = static_cast<unsigned char>(value >> 24);
+    p[1] = static_cast<unsigned char>(value >> 16);
+    p[2] = static_cast<unsigned char>(value >> 8);
+    p[3] = static_cast<unsigned char>(value);
+}
+
+void putU16(unsigned char* p, std::uint16_t value) noexcept {
+    p[0] = static_cast<unsigned char>(value >> 8);
+    p[1] = static_cast<unsigned char>(value);
+}
+
+// Little-endian counterparts for the BMP/DIB headers
+void putLe32(unsigned char* p, std::uint32_t value) noexcept {
+    p[0] = static_cast<unsigned char>(value);
+    p[1] = static_cast<unsigned char>(value >> 8);
+    p[2] = static_cast<unsigned char>(value >> 16);
+    p[3] = static_cast<unsigned char>(value >> 24);
+}
+
+void putLe16(unsigned char* p, std::uint16_t value) noexcept {
+    p[0] = static_cast<unsigned char>(value);
+    p[1] = static_cast<unsigned char>(value >> 8);
+}
+
+// Text chunk keywords for PngMetadata
+constexpr const char* hashKeyword    = "QRTextFetch hash";
+constexpr const char* payloadKeyword = "QRTextFetch payload";
+constexpr std::size_t minCompressedText = 256;
+// Text chunks longer than this are skipped by readPngMetadata rather than read; a payload fits
+// in a few kilobytes, so only a damaged or hostile file comes near it
+constexpr std::uint32_t maxTextChunk = std::uint32_t{4} << 20;
+
+constexpr unsigned char pngSignature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+constexpr std::size_t bmpFileHeaderSize = 14;
+constexpr std::size_t dibHeaderSize     = 40;     // BITMAPINFOHEADER
+constexpr std::size_t dibPaletteSize    = 2 * 4;  // Black, white as RGBQUAD
+
+
+// A PNG being assembled chunk by chunk with lodepng's chunk API, which owns a malloc'd buffer.
+class ChunkWriter final {
+public:
+    ChunkWriter() {
+        data_ = static_cast<unsigned char*>(std::malloc(sizeof(pngSignature)));
+        if (data_) {
+            std::memcpy(data_, pngSignature, sizeof(pngSignature));
+            size_ = sizeof(pngSignature);
+        }
+    }
+    ~ChunkWriter() { std::free(data_); }
+    ChunkWriter(const ChunkWriter&) = delete;
+    ChunkWriter& operator=(const ChunkWriter&) = delete;
+
+    [[nodiscard]]
+    bool append(const unsigned char* chunk) noexcept {
+        return data_ && lodepng_chunk_append(&data_, &size_, chunk) == 0u;
+    }
+
+    [[nodiscard]]
+    bool create(const char* type, const unsigned char* payload, std::size_t length) noexcept {
+        return data_ && lodepng_chunk_create(&data_, &size_, length, type, payload) == 0u;
+    }
+
+    [[nodiscard]]
+    std::vector<unsigned char> release() const {
+        return data_ ? std::vector<unsigned char>(data_, data_ + size_) : std::vector<unsigned char>();
+    }
+
+private:
+    unsigned char* data_ = nullptr;
+    std::size_t    size_ = 0;
+};
+
+// Runs work(i) for every i in [0, count) on up to hardware_concurrency threads, including the
+// calling one. Returns false if any call returned false or threw.
+template <typename Work>
+[[nodiscard]]
+bool parallelFor(std::size_t count, const Work& work) {
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> failed{false};
+    const auto worker = [&]() noexcept {
+        try {
+            for (std::size_t i; !failed && (i = next++) < count; ) {
+                if (!work(i)) {
+                    failed = true;
+                }
+            }
+        }
+        catch (...) {
+            failed = true;
+        }
+    };
+    const std::size_t numThreads = std::min<std::size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < numThreads; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+    return !failed;
+}
+
+// 3x5 pixel digits for contact sheet captions, one 15-bit row-major mask per digit.
+constexpr std::uint16_t digitGlyphs[10] = {
+    0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249, 0x7BEF, 0x7BCF,
+};
+
+// Clears (darkens) pixels [x0, x1) in a packed 1-bit row where 1 is light.
+void darkenSpan(unsigned char* row, int x0, int x1) noexcept {
+    for (int x = x0; x < x1; ++x) {
+        row[x >> 3] = static_cast<unsigned char>(row[x >> 3] & ~(0x80 >> (x & 7)));
+    }
+}
+
+// Writes a 1-bit DIB (header, palette, bottom-up rows) for the code at `offset` in out,
+// which must already have room for it.
+void writeDib(std::vector<unsigned char>& out, std::size_t offset,
+              const qrcodegen::QrCode& qr, int scale, int border) {
+    const int size    = qr.getSize();
+    const int imgSize = (size + border * 2) * scale;
+    const std::size_t rowBytes = (static_cast<std::size_t>(imgSize) + 31) / 32 * 4;
+
+    unsigned char* header = &out[offset];
+    putLe32(header + 0, static_cast<std::uint32_t>(dibHeaderSize));
+    putLe32(header + 4, static_cast<std::uint32_t>(imgSize));
+    putLe32(header + 8, static_cast<std::uint32_t>(imgSize));    // Positive: bottom-up rows
+    putLe16(header + 12, 1);                                     // Planes
+    putLe16(header + 14, 1);                                     // Bits per pixel
+    putLe32(header + 16, 0);                                     // BI_RGB, uncompressed
+    putLe32(header + 20, static_cast<std::uint32_t>(rowBytes * static_cast<std::size_t>(imgSize)));
+    putLe32(header + 24, 3780);                                  // 96 DPI in pixels per metre
+    putLe32(header + 28, 3780);
+    putLe32(header + 32, 2);                                     // Palette entries used
+    putLe32(header + 36, 2);
+    unsigned char* palette = header + dibHeaderSize;
+    std::fill_n(palette, 4, 0);                                  // Index 0: black
+    std::fill_n(palette + 4, 3, 255);                            // Index 1: white
+    palette[7] = 0;
+
+    // Rows start light (all ones, padding included); each module row is drawn once as dark
+    // runs and copied to its other scale - 1 pixel rows
+    unsigned char* bits = palette + dibPaletteSize;
+    std::fill_n(bits, rowBytes * static_cast<std::size_t>(imgSize), 0xFF);
+    for (int qrY = 0; qrY < size; ++qrY) {
+        // Bottom-up: the first pixel row of module row qrY is image row (qrY + border) * scale from the top
+        const int firstRow = imgSize - 1 - (qrY + border) * scale;
+        unsigned char* row = bits + static_cast<std::size_t>(firstRow) * rowBytes;
+        for (int qrX = 0; qrX < size; ) {
+            if (!qr.getModule(qrX, qrY)) {
+                ++qrX;
+                continue;
+            }
+            int runEnd = qrX + 1;
+            while (runEnd < size && qr.getModule(runEnd, qrY)) {
+                ++runEnd;
+            }
+            darkenSpan(row, (qrX + border) * scale, (runEnd + border) * scale);
+            qrX = runEnd;
+        }
+        for (int i = 1; i < scale; ++i) {
+            std::memcpy(row - static_cast<std::ptrdiff_t>(i * rowBytes), row, rowBytes);
+        }
+    }
+}
+
+// Appends "x y w h re" path operators covering the dark modules of a code, in module units.
+// Horizontal runs are found per row, and a run with the same span as one in the row above
+// extends that rectangle downwards instead of starting a new one.
+void appendModuleRects(std::string& out, const qrcodegen::QrCode& qr) {
+    struct OpenRect {
+        int x0, x1, y0;
+    };
+    const int size = qr.getSize();
+    std::vector<OpenRect> open, next;
+    char buffer[48];
+    const auto emit = [&](const OpenRect& r, int yEnd) {
+        const int n = std::snprintf(buffer, sizeof(buffer), "%d %d %d %d re\n", r.x0, r.y0, r.x1 - r.x0, yEnd - r.y0);
+        out.append(buffer, static_cast<std::size_t>(n));
+    };
+
+    for (int y = 0; y <= size; ++y) {
+        next.clear();
+        std::size_t o = 0;  // Both lists are sorted by x0, so they are merged in one pass
+        for (int x = 0; y < size && x < size; ) {
+            if (!qr.getModule(x, y)) {
+                ++x;
+                continue;
+            }
+            int end = x + 1;
+            while (end < size && qr.getModule(end, y)) {
+                ++end;
+            }
+            while (o < open.size() && open[o].x0 < x) {
+                emit(open[o++], y);
+            }
+            if (o < open.size() && open[o].x0 == x && open[o].x1 == end) {
+                next.push_back(open[o++]);
+            } else {
+                next.push_back({x, end, y});
+            }
+            x = end;
+        }
+        while (o < open.size()) {
+            emit(open[o++], y);
+        }
+        open.swap(next);
+    }
+}
+
+[[nodiscard]]
+std::string formatPoints(double value) {
+    char buffer[32];
+    const int n = std::snprintf(buffer, sizeof(buffer), "%.2f", value);
+    return std::string(buffer, static_cast<std::size_t>(n));
+}
+
+// Shared by the QrCode and CodeView overloads, which answer the same queries.
+template <typename Code>
+[[nodiscard]]
+std::vector<unsigned char> renderGreyscaleOf(const Code& qr, int scale, int border) {
+    const int size    = qr.getSize();
+    const int imgSize = (size + border * 2) * scale;
+    const std::size_t stride = static_cast<std::size_t>(imgSize);
+
+    std::vector<unsigned char> image(stride * stride, 255);
+    for (int qrY = 0; qrY < size; ++qrY) {
+        const std::size_t rowStart = static_cast<std::size_t>((qrY + border) * scale) * stride;
+        for (int qrX = 0; qrX < size; ++qrX) {
+            if (qr.getModule(qrX, qrY)) {
+                std::fill_n(image.begin() + static_cast<std::ptrdiff_t>(rowStart + (qrX + border) * scale), scale, 0);
+            }
+        }
+        for (int i = 1; i < scale; ++i) {
+            std::copy_n(image.begin() + static_cast<std::ptrdiff_t>(rowStart), stride,
+                        image.begin() + static_cast<std::ptrdiff_t>(rowStart + i * stride));
+        }
+    }
+    return image;
+}
+
+} // namespace
+
+std::vector<unsigned char> renderGreyscale(const qrcodegen::QrCode& qr, int scale, int border) {
+    return renderGreyscaleOf(qr, scale, border);
+}
+
+std::vector<unsigned char> renderGreyscale(const qrcache::CodeView& qr, int scale, int border) {
+    return renderGreyscaleOf(qr, scale, border);
+}
+
+std::vector<unsigned char> renderGreyscale(const qrcodegen::MicroQrCode& qr, int scale, int border) {
+    return renderGreyscaleOf(qr, scale, border);
+}
+
+std::vector<unsigned char> encodeGreyscalePng(const std::vector<unsigned char>& image, unsigned side,
+                                              const PngMetadata* metadata) {
+    lodepng::State state;
+    state.info_raw.colortype       = LCT_GREY;
+    state.info_raw.bitdepth        = 8;
+    state.info_png.color.colortype = LCT_GREY;
+    state.info_png.color.bitdepth  = 1;
+    state.encoder.auto_convert     = 0;
+    if (metadata) {
+        char hash[17];
+        std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(metadata->payloadHash));
+        // Compression applies to every text chunk, and the zlib overhead only pays off on long text
+        state.encoder.text_compression = metadata->payload.size() > minCompressedText ? 1u : 0u;
+        if (lodepng_add_text(&state.info_png, hashKeyword, hash) != 0u
+                || (!metadata->payload.empty()
+                    && lodepng_add_itext(&state.info_png, payloadKeyword, "", "", metadata->payload.c_str()) != 0u)) {
+            return {};
+        }
+    }
+    std::vector<unsigned char> png;
+    if (lodepng::encode(png, image, side, side, state) != 0u) {
+        return {};
+    }
+    return png;
+}
+
+bool readPngMetadata(const std::string& filename, bool withPayload, PngMetadata& metadata,
+                     unsigned& width, unsigned& height) {
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return false;
+    }
+    const std::streamoff fileSize = in.tellg();
+    in.seekg(0);
+    // Collect the signature, IHDR and text chunks into a small PNG-shaped buffer for lodepng
+    std::vector<unsigned char> head(8);
+    if (!in.read(reinterpret_cast<char*>(head.data()), 8)
+            || std::memcmp(head.data(), pngSignature, sizeof(pngSignature)) != 0) {
+        return false;
+    }
+    for (;;) {
+        unsigned char header[8];
+        if (!in.read(reinterpret_cast<char*>(header), 8)) {
+            break;  // Truncated; use what was found
+        }
+        const std::uint32_t length = (static_cast<std::uint32_t>(header[0]) << 24) | (static_cast<std::uint32_t>(header[1]) << 16)
+                                   | (static_cast<std::uint32_t>(header[2]) << 8) | header[3];
+        const unsigned char* type = header + 4;
+        if (std::memcmp(type, "IEND", 4) == 0 || length > 0x7FFFFFFFu) {
+            break;
+        }
+        // A chunk claiming more bytes than the file has left is truncated, and is not read
+        const std::streamoff left = fileSize - static_cast<std::streamoff>(in.tellg());
+        const bool wanted = (std::memcmp(type, "IHDR", 4) == 0 || std::memcmp(type, "tEXt", 4) == 0
+                             || std::memcmp(type, "zTXt", 4) == 0 || (withPayload && std::memcmp(type, "iTXt", 4) == 0))
+                         && length <= maxTextChunk && static_cast<std::streamoff>(length) + 4 <= left;
+        if (!wanted) {
+            in.seekg(static_cast<std::streamoff>(length) + 4, std::ios::cur);  // Data and CRC
+            continue;
+        }
+        const std::size_t start = head.size();
+        head.resize(start + 12 + length);
+        std::memcpy(head.data() + start, header, 8);
+        if (!in.read(reinterpret_cast<char*>(head.data() + start + 8), static_cast<std::streamsize>(length) + 4)) {
+            head.resize(start);
+            break;
+        }
+    }
+
+    lodepng::State state;
+    if (lodepng_inspect(&width, &height, &state, head.data(), head.size()) != 0u) {
+        return false;
+    }
+    const unsigned char* const end = head.data() + head.size();
+    for (const char* type : {"tEXt", "zTXt", "iTXt"}) {
+        for (const unsigned char* chunk = lodepng_chunk_find_const(head.data() + 8, end, type); chunk;
+                chunk = lodepng_chunk_find_const(lodepng_chunk_next_const(chunk, end), end, type)) {
+            // Unreadable chunks are skipped rather than failing the whole file
+            (void)lodepng_inspect_chunk(&state, static_cast<std::size_t>(chunk - head.data()), head.data(), head.size());
+        }
+    }
+
+    bool found = false;
+    metadata = PngMetadata{};
+    for (std::size_t i = 0; i < state.info_png.text_num; ++i) {
+        if (std::strcmp(state.info_png.text_keys[i], hashKeyword) == 0) {
+            char* parsedEnd = nullptr;
+            metadata.payloadHash = std::strtoull(state.info_png.text_strings[i], &parsedEnd, 16);
+            found = parsedEnd && *parsedEnd == '\0' && parsedEnd != state.info_png.text_strings[i];
+        }
+    }
+    for (std::size_t i = 0; i < state.info_png.itext_num; ++i) {
+        if (std::strcmp(state.info_png.itext_keys[i], payloadKeyword) == 0) {
+            metadata.payload = state.info_png.itext_strings[i];
+        }
+    }
+    return found;
+}
+
+std::vector<unsigned char> encodePng(const qrcodegen::QrCode& qr, int scale, int border) {
+    const int size    = qr.getSize();
+    const int imgSize = (size + border * 2) * scale;
+
+    std::vector<unsigned char> image(static_cast<std::size_t>(imgSize) * imgSize * 4u, 255);
+
+    for (int y = 0; y < imgSize; ++y) {
+        for (int x = 0; x < imgSize; ++x) {
+            const int qrX = (x / scale) - border;
+            const int qrY = (y / scale) - border;
+
+            const bool isBlack =
+                (qrX >= 0 && qrX < size && qrY >= 0 && qrY < size) &&
+                qr.getModule(qrX, qrY);
+
+            if (isBlack) {
+                const std::size_t index =
+                    (static_cast<std::size_t>(y) * imgSize + x) * 4u;
+                image[index + 0] = 0;
+                image[index + 1] = 0;
+                image[index + 2] = 0;
+                image[index + 3] = 255;
+            }
+        }
+    }
+
+    return encodeRaw(image, imgSize, LCT_RGBA);
+}
+
+std::vector<unsigned char> encodeDib(const qrcodegen::QrCode& qr, int scale, int border) {
+    const std::size_t imgSize  = static_cast<std::size_t>((qr.getSize() + border * 2) * scale);
+    const std::size_t rowBytes = (imgSize + 31) / 32 * 4;
+    std::vector<unsigned char> dib(dibHeaderSize + dibPaletteSize + rowBytes * imgSize);
+    writeDib(dib, 0, qr, scale, border);
+    return dib;
+}
+
+std::vector<unsigned char> encodeBmp(const qrcodegen::QrCode& qr, int scale, int border) {
+    const std::size_t imgSize  = static_cast<std::size_t>((qr.getSize() + border * 2) * scale);
+    const std::size_t rowBytes = (imgSize + 31) / 32 * 4;
+    const std::size_t bitsOffset = bmpFileHeaderSize + dibHeaderSize + dibPaletteSize;
+    std::vector<unsigned char> bmp(bitsOffset + rowBytes * imgSize);
+
+    // BITMAPFILEHEADER
+    bmp[0] = 'B';
+    bmp[1] = 'M';
+    putLe32(&bmp[2], static_cast<std::uint32_t>(bmp.size()));
+    putLe32(&bmp[10], static_cast<std::uint32_t>(bitsOffset));
+    writeDib(bmp, bmpFileHeaderSize, qr, scale, border);
+    return bmp;
+}
+
+std::vector<unsigned char> encodeColorPng(const std::array<const qrcodegen::QrCode*, 3>& layers,
+                                          int scale, int border) {
+    const int size = layers[0]->getSize();
+    if (layers[1]->getSize() != size || layers[2]->getSize() != size) {
+        throw std::invalid_argument("Colour layers must have the same size");
+    }
+    const int imgSize = (size + border * 2) * scale;
+
+    std::vector<unsigned char> image(static_cast<std::size_t>(imgSize) * imgSize * 3u, 255);
+
+    // Fill one module row of pixels, then copy it down for the remaining scale - 1 rows
+    const std::size_t stride = static_cast<std::size_t>(imgSize) * 3u;
+    for (int qrY = 0; qrY < size; ++qrY) {
+        const std::size_t rowStart = static_cast<std::size_t>((qrY + border) * scale) * stride;
+        for (int qrX = 0; qrX < size; ++qrX) {
+            for (int c = 0; c < 3; ++c) {
+                if (!layers[static_cast<std::size_t>(c)]->getModule(qrX, qrY)) {
+                    continue;
+                }
+                std::size_t index = rowStart + static_cast<std::size_t>((qrX + border) * scale) * 3u + c;
+                for (int i = 0; i < scale; ++i, index += 3) {
+                    image[index] = 0;
+                }
+            }
+        }
+        for (int i = 1; i < scale; ++i) {
+            std::copy_n(image.begin() + static_cast<std::ptrdiff_t>(rowStart), stride,
+                        image.begin() + static_cast<std::ptrdiff_t>(rowStart + i * stride));
+        }
+    }
+
+    return encodeRaw(image, imgSize, LCT_RGB);
+}
+
+std::array<std::vector<unsigned char>, 3> splitColorPng(const std::vector<unsigned char>& png) {
+    std::vector<unsigned char> rgb;
+    unsigned width = 0, height = 0;
+    if (lodepng::decode(rgb, width, height, png, LCT_RGB) != 0u) {
+        return {};
+    }
+
+    const std::size_t numPixels = static_cast<std::size_t>(width) * height;
+    std::array<std::vector<unsigned char>, 3> result;
+    std::vector<unsigned char> grey(numPixels);
+    for (int c = 0; c < 3; ++c) {
+        for (std::size_t i = 0; i < numPixels; ++i) {
+            grey[i] = rgb[i * 3u + static_cast<std::size_t>(c)];
+        }
+        std::vector<unsigned char> pngData;
+        if (lodepng::encode(pngData, grey, width, height, LCT_GREY) != 0u) {
+            return {};
+        }
+        result[static_cast<std::size_t>(c)] = std::move(pngData);
+    }
+    return result;
+}
+
+std::vector<bool> sampleModules(const std::vector<unsigned char>& pixels, unsigned width,
+                                int channels, int channel, int size, int scale, int border) {
+    // Average the central half of each module, which tolerates a blur of up to scale / 4
+    const int margin = scale / 4;
+    const int span   = scale - 2 * margin;
+    const int threshold = 128 * span * span;
+
+    std::vector<bool> modules(static_cast<std::size_t>(size) * size);
+    for (int qrY = 0; qrY < size; ++qrY) {
+        for (int qrX = 0; qrX < size; ++qrX) {
+            const int left = (qrX + border) * scale + margin;
+            const int top  = (qrY + border) * scale + margin;
+            int sum = 0;
+            for (int y = top; y < top + span; ++y) {
+                std::size_t index = (static_cast<std::size_t>(y) * width + left) * channels + channel;
+                for (int x = 0; x < span; ++x, index += static_cast<std::size_t>(channels)) {
+                    sum += pixels[index];
+                }
+            }
+            modules[static_cast<std::size_t>(qrY) * size + qrX] = sum < threshold;
+        }
+    }
+    return modules;
+}
+
+std::size_t maxBytesPerCode(int version, qrcodegen::QrCode::Ecc ecc) {
+    if (version < qrcodegen::QrCode::MIN_VERSION || version > qrcodegen::QrCode::MAX_VERSION) {
+        throw std::invalid_argument("Version out of range");
+    }
+    return static_cast<std::size_t>(qrcodegen::QrCode::getMaxPayload(version, ecc, qrcodegen::QrSegment::Mode::BYTE));
+}
+
+std::vector<qrcodegen::QrCode> encodeParts(const std::string& text, int version, qrcodegen::QrCode::Ecc ecc) {
+    const std::size_t capacity = maxBytesPerCode(version, ecc);
+    std::vector<qrcodegen::QrCode> codes;
+    for (std::size_t begin = 0; begin < text.length(); ) {
+        std::size_t end = std::min(begin + capacity, text.length());
+        while (end > begin && end < text.length() && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) {
+            --end;
+        }
+        if (end == begin) {
+            throw qrcodegen::data_too_long("Version too small for one character");
+        }
+        const std::string part = text.substr(begin, end - begin);
+        codes.push_back(qrcodegen::QrCode::encodeSegments(
+            qrcodegen::QrSegment::makeSegments(part.c_str()), ecc, version, version));
+        begin = end;
+    }
+    return codes;
+}
+
+std::vector<unsigned char> encodeApng(const std::vector<qrcodegen::QrCode>& frames, int scale, int border,
+                                      int framesPerSecond) {
+    if (frames.empty()) {
+        throw std::invalid_argument("No frames");
+    }
+    if (framesPerSecond < 1 || framesPerSecond > 100) {
+        throw std::invalid_argument("Frame rate out of range");
+    }
+    const int size = frames[0].getSize();
+    for (const auto& qr : frames) {
+        if (qr.getSize() != size) {
+            throw std::invalid_argument("Frames must have the same size");
+        }
+    }
+    const unsigned imgSize = static_cast<unsigned>((size + border * 2) * scale);
+
+    // Encode every frame as a standalone 1-bit greyscale PNG. The colour mode is fixed rather
+    // than auto-selected so that all frames agree with the IHDR taken from the first one.
+    std::vector<std::vector<unsigned char>> pngs(frames.size());
+    const bool encoded = parallelFor(frames.size(), [&](std::size_t i) {
+        pngs[i] = encodeGreyscalePng(renderGreyscale(frames[i], scale, border), imgSize);
+        return !pngs[i].empty();
+    });
+    if (!encoded) {
+        return {};
+    }
+
+    // Assemble: IHDR, acTL, then per frame an fcTL followed by the image data, which is
+    // IDAT for the first frame and fdAT (IDAT payload behind a sequence number) for the rest
+    ChunkWriter out;
+    std::uint32_t sequence = 0;
+    unsigned char actl[8];
+    putU32(actl + 0, static_cast<std::uint32_t>(frames.size()));
+    putU32(actl + 4, 0);  // Loop forever
+    bool ok = true;
+    for (std::size_t i = 0; i < pngs.size() && ok; ++i) {
+        const unsigned char* const end = pngs[i].data() + pngs[i].size();
+        const unsigned char* chunk = pngs[i].data() + 8;
+        if (i == 0) {
+            ok = lodepng_chunk_type_equals(chunk, "IHDR") && out.append(chunk) && out.create("acTL", actl, sizeof(actl));
+        }
+
+        unsigned char fctl[26];
+        putU32(fctl +  0, sequence++);
+        putU32(fctl +  4, imgSize);
+        putU32(fctl +  8, imgSize);
+        putU32(fctl + 12, 0);  // x offset
+        putU32(fctl + 16, 0);  // y offset
+        putU16(fctl + 20, 1);  // Delay is 1/fps seconds
+        putU16(fctl + 22, static_cast<std::uint16_t>(framesPerSecond));
+        fctl[24] = 0;  // APNG_DISPOSE_OP_NONE
+        fctl[25] = 0;  // APNG_BLEND_OP_SOURCE
+        ok = ok && out.create("fcTL", fctl, sizeof(fctl));
+
+        std::vector<unsigned char> fdat;
+        for (; ok && chunk + 12 <= end && !lodepng_chunk_type_equals(chunk, "IEND");
+               chunk = lodepng_chunk_next_const(chunk, end)) {
+            if (!lodepng_chunk_type_equals(chunk, "IDAT")) {
+                continue;
+            }
+            if (i == 0) {
+                ok = out.append(chunk);
+                continue;
+            }
+            const unsigned length = lodepng_chunk_length(chunk);
+            const unsigned char* const data = lodepng_chunk_data_const(chunk);
+            fdat.resize(4u + length);
+            putU32(fdat.data(), sequence++);
+            std::copy_n(data, length, fdat.begin() + 4);
+            ok = out.create("fdAT", fdat.data(), fdat.size());
+        }
+    }
+    if (!ok || !out.create("IEND", nullptr, 0)) {
+        return {};
+    }
+    return out.release();
+}
+
+std::vector<unsigned char> encodeContactSheet(const std::vector<qrcodegen::QrCode>& codes, int columns,
+                                              int scale, int border) {
+    if (codes.empty()) {
+        throw std::invalid_argument("No codes");
+    }
+    const int count = static_cast<int>(codes.size());
+    if (columns <= 0) {
+        columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+    }
+    columns = std::min(columns, count);
+    const int rows = (count + columns - 1) / columns;
+
+    int maxSize = 0;
+    for (const auto& qr : codes) {
+        maxSize = std::max(maxSize, qr.getSize());
+    }
+    const int glyphScale    = std::max(1, scale / 2);
+    const int captionHeight = 7 * glyphScale;  // 5-pixel glyphs with a 1-pixel margin above and below
+    const int tileWidth     = (maxSize + border * 2) * scale;
+    const int tileHeight    = tileWidth + captionHeight;
+    const int width         = tileWidth * columns;
+    const int height        = tileHeight * rows;
+    const std::size_t rowBytes = 1u + (static_cast<std::size_t>(width) + 7) / 8;  // Filter byte plus packed pixels
+
+    // Every byte starts light (1 bits) with filter type 0; each grid row owns its band of scanlines
+    std::vector<unsigned char> raw(rowBytes * static_cast<std::size_t>(height), 0xFF);
+    for (std::size_t y = 0; y < static_cast<std::size_t>(height); ++y) {
+        raw[y * rowBytes] = 0;
+    }
+
+    const bool rendered = parallelFor(static_cast<std::size_t>(rows), [&](std::size_t gridRow) {
+        unsigned char* const band = raw.data() + gridRow * tileHeight * rowBytes;
+        for (int col = 0; col < columns; ++col) {
+            const int index = static_cast<int>(gridRow) * columns + col;
+            if (index >= count) {
+                break;
+            }
+            const auto& qr = codes[static_cast<std::size_t>(index)];
+            const int size   = qr.getSize();
+            const int offset = (maxSize - size) / 2 * scale;
+            const int left   = col * tileWidth + border * scale + offset;
+            const int top    = border * scale + offset;
+
+            // Darken each run of dark modules on all scale pixel rows. Bytes can be shared with the
+            // neighbouring tile when the quiet zone is narrow, so rows are not copied bytewise.
+            for (int qrY = 0; qrY < size; ++qrY) {
+                unsigned char* const row = band + (top + qrY * scale) * rowBytes + 1;
+                for (int qrX = 0; qrX < size; ) {
+                    if (!qr.getModule(qrX, qrY)) {
+                        ++qrX;
+                        continue;
+                    }
+                    int runEnd = qrX + 1;
+                    while (runEnd < size && qr.getModule(runEnd, qrY)) {
+                        ++runEnd;
+                    }
+                    for (int i = 0; i < scale; ++i) {
+                        darkenSpan(row + i * rowBytes, left + qrX * scale, left + runEnd * scale);
+                    }
+                    qrX = runEnd;
+                }
+            }
+
+            // Caption: the 1-based index centred under the code, left out where it is wider than the
+            // tile (a narrow border at scale 1), as it would run into the neighbouring tiles
+            const std::string label = std::to_string(index + 1);
+            const int labelWidth = (static_cast<int>(label.length()) * 4 - 1) * glyphScale;
+            if (labelWidth > tileWidth) {
+                continue;
+            }
+            const int labelLeft  = col * tileWidth + (tileWidth - labelWidth) / 2;
+            for (int gy = 0; gy < 5; ++gy) {
+                unsigned char* const row = band + (tileWidth + (1 + gy) * glyphScale) * rowBytes + 1;
+                for (std::size_t d = 0; d < label.length(); ++d) {
+                    const std::uint16_t glyph = digitGlyphs[label[d] - '0'];
+                    for (int gx = 0; gx < 3; ++gx) {
+                        if ((glyph >> (14 - gy * 3 - gx)) & 1) {
+                            const int x = labelLeft + (static_cast<int>(d) * 4 + gx) * glyphScale;
+                            darkenSpan(row, x, x + glyphScale);
+                        }
+                    }
+                }
+                for (int i = 1; i < glyphScale; ++i) {
+                    std::copy(row, row + rowBytes - 1, row + i * rowBytes);
+                }
+            }
+        }
+        return true;
+    });
+    if (!rendered) {
+        return {};
+    }
+
+    unsigned char* zlib = nullptr;
+    std::size_t zlibSize = 0;
+    const unsigned error = lodepng_zlib_compress(&zlib, &zlibSize, raw.data(), raw.size(),
+                                                 &lodepng_default_compress_settings);
+    std::unique_ptr<unsigned char, decltype(&std::free)> zlibOwner(zlib, &std::free);
+    if (error != 0u) {
+        return {};
+    }
+
+    unsigned char ihdr[13];
+    putU32(ihdr + 0, static_cast<std::uint32_t>(width));
+    putU32(ihdr + 4, static_cast<std::uint32_t>(height));
+    ihdr[8]  = 1;  // Bit depth
+    ihdr[9]  = 0;  // Greyscale
+    ihdr[10] = 0;  // Deflate
+    ihdr[11] = 0;  // Adaptive filtering
+    ihdr[12] = 0;  // No interlace
+
+    ChunkWriter out;
+    if (!out.create("IHDR", ihdr, sizeof(ihdr)) || !out.create("IDAT", zlib, zlibSize)
+            || !out.create("IEND", nullptr, 0)) {
+        return {};
+    }
+    return out.release();
+}
+
+std::vector<unsigned char> encodePdf(const std::vector<qrcodegen::QrCode>& codes, const PdfLayout& layout) {
+    if (codes.empty()) {
+        throw std::invalid_argument("No codes");
+    }
+    int maxSize = 0;
+    for (const auto& qr : codes) {
+        maxSize = std::max(maxSize, qr.getSize());
+    }
+    const double captionHeight = layout.captions ? 8.0 : 0.0;
+    const double tileWidth  = (maxSize + layout.border * 2) * layout.moduleSize;
+    const double tileHeight = tileWidth + captionHeight;
+    const int columns = static_cast<int>((layout.pageWidth - 2 * layout.margin) / tileWidth);
+    const int rows    = static_cast<int>((layout.pageHeight - 2 * layout.margin) / tileHeight);
+    if (columns <= 0 || rows <= 0) {
+        throw std::invalid_argument("Codes do not fit on the page");
+    }
+    const std::size_t perPage  = static_cast<std::size_t>(columns) * static_cast<std::size_t>(rows);
+    const std::size_t numPages = (codes.size() + perPage - 1) / perPage;
+
+    // Page content streams, deflated in parallel
+    std::vector<std::vector<unsigned char>> contents(numPages);
+    const bool rendered = parallelFor(numPages, [&](std::size_t page) {
+        std::string content;
+        const std::size_t first = page * perPage;
+        const std::size_t last  = std::min(codes.size(), first + perPage);
+        for (std::size_t index = first; index < last; ++index) {
+            const auto& qr = codes[index];
+            const int cell = static_cast<int>(index - first);
+            const double tileLeft = layout.margin + (cell % columns) * tileWidth;
+            const double tileTop  = layout.pageHeight - layout.margin - (cell / columns) * tileHeight;
+            const double offset   = ((maxSize - qr.getSize()) / 2 + layout.border) * layout.moduleSize;
+
+            // Module space: origin at the code's top-left corner, y downwards, one unit per module
+            content += "q " + formatPoints(layout.moduleSize) + " 0 0 " + formatPoints(-layout.moduleSize) + " "
+                     + formatPoints(tileLeft + offset) + " " + formatPoints(tileTop - offset) + " cm\n";
+            appendModuleRects(content, qr);
+            content += "f Q\n";
+
+            if (layout.captions) {
+                const std::string label = std::to_string(index + 1);
+                // Helvetica digits are 0.556 em wide
+                const double labelWidth = 6.0 * 0.556 * static_cast<double>(label.length());
+                content += "BT /F1 6 Tf " + formatPoints(tileLeft + (tileWidth - labelWidth) / 2) + " "
+                         + formatPoints(tileTop - tileWidth - 6.0) + " Td (" + label + ") Tj ET\n";
+            }
+        }
+
+        unsigned char* deflated = nullptr;
+        std::size_t deflatedSize = 0;
+        LodePNGCompressSettings settings;
+        lodepng_compress_settings_init(&settings);
+        // Repeats in the operators are short range, so a small window compresses as well and much faster
+        settings.windowsize = 256;
+        const unsigned error = lodepng_zlib_compress(&deflated, &deflatedSize,
+            reinterpret_cast<const unsigned char*>(content.data()), content.size(), &settings);
+        if (error == 0u) {
+            contents[page].assign(deflated, deflated + deflatedSize);
+        }
+        std::free(deflated);
+        return error == 0u;
+    });
+    if (!rendered) {
+        return {};
+    }
+
+    // Objects: 1 catalog, 2 page tree, 3 font, then each page and its content stream
+    const std::size_t numObjects = 3 + 2 * numPages;
+    std::vector<std::size_t> offsets(numObjects + 1, 0);
+    std::vector<unsigned char> pdf;
+    const auto write = [&pdf](const std::string& text) { pdf.insert(pdf.end(), text.begin(), text.end()); };
+    const auto beginObject = [&](std::size_t number) {
+        offsets[number] = pdf.size();
+        write(std::to_string(number) + " 0 obj\n");
+    };
+
+    write("%PDF-1.4\n%\xE2\xE3\xCF\xD3\n");
+    beginObject(1);
+    write("<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+    beginObject(2);
+    write("<< /Type /Pages /Count " + std::to_string(numPages) + " /Kids [");
+    for (std::size_t page = 0; page < numPages; ++page) {
+        write(std::to_string(4 + 2 * page) + " 0 R ");
+    }
+    write("] >>\nendobj\n");
+    beginObject(3);
+    write("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>\nendobj\n");
+
+    const std::string mediaBox = "[0 0 " + formatPoints(layout.pageWidth) + " " + formatPoints(layout.pageHeight) + "]";
+    for (std::size_t page = 0; page < numPages; ++page) {
+        const std::size_t pageObject = 4 + 2 * page;
+        beginObject(pageObject);
+        write("<< /Type /Page /Parent 2 0 R /MediaBox " + mediaBox
+              + " /Resources << /Font << /F1 3 0 R >> >> /Contents " + std::to_string(pageObject + 1) + " 0 R >>\nendobj\n");
+        beginObject(pageObject + 1);
+        write("<< /Length " + std::to_string(contents[page].size()) + " /Filter /FlateDecode >>\nstream\n");
+        pdf.insert(pdf.end(), contents[page].begin(), contents[page].end());
+        write("\nendstream\nendobj\n");
+        std::vector<unsigned char>().swap(contents[page]);
+    }
+
+    // Cross-reference entries are exactly 20 bytes each
+    const std::size_t xrefOffset = pdf.size();
+    write("xref\n0 " + std::to_string(numObjects + 1) + "\n0000000000 65535 f \n");
+    for (std::size_t number = 1; number <= numObjects; ++number) {
+        char entry[24];
+        std::snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offsets[number]);
+        write(entry);
+    }
+    write("trailer\n<< /Size " + std::to_string(numObjects + 1) + " /Root 1 0 R >>\nstartxref\n"
+          + std::to_string(xrefOffset) + "\n%%EOF\n");
+    return pdf;
+}
+
+std::string renderTerminal(const qrcodegen::QrCode& qr, int border, TerminalStyle style) {
+    static constexpr char reset[] = "\x1b[0m\n";
+    const int size = qr.getSize();
+    const int dim  = size + border * 2;
+    const auto isDark = [&](int x, int y) { return qr.getModule(x - border, y - border); };
+
+    std::string out;
+    if (style == TerminalStyle::HalfBlocks) {
+        // Black foreground on bright white: a drawn half is a dark module. The glyphs are
+        // 3 bytes in UTF-8; an odd last row pairs with a light row below the code.
+        static constexpr char colours[] = "\x1b[30;107m";
+        // Index top * 2 + bottom: space, U+2584 lower half, U+2580 upper half, U+2588 full block
+        static constexpr const char* glyphs[4] = {" ", "\xE2\x96\x84", "\xE2\x96\x80", "\xE2\x96\x88"};
+        const int lines = (dim + 1) / 2;
+        out.reserve(static_cast<std::size_t>(lines) * (sizeof(colours) - 1 + static_cast<std::size_t>(dim) * 3 + sizeof(reset) - 1));
+        for (int y = 0; y < dim; y += 2) {
+            out += colours;
+            for (int x = 0; x < dim; ++x) {
+                out += glyphs[(isDark(x, y) ? 2 : 0) + (isDark(x, y + 1) ? 1 : 0)];
+            }
+            out += reset;
+        }
+    } else {
+        // Colour escapes only where the module colour changes along the row
+        static constexpr char dark[] = "\x1b[40m";
+        static constexpr char light[] = "\x1b[107m";
+        out.reserve(static_cast<std::size_t>(dim) * (static_cast<std::size_t>(dim) * (sizeof(light) - 1 + 2) + sizeof(reset) - 1));
+        for (int y = 0; y < dim; ++y) {
+            int current = -1;
+            for (int x = 0; x < dim; ++x) {
+                const int module = isDark(x, y) ? 1 : 0;
+                if (module != current) {
+                    out += module ? dark : light;
+                    current = module;
+                }
+                out += "  ";
+            }
+            out += reset;
+        }
+    }
+    return out;
+}
+
+} // namespace qrexport
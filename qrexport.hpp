@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "qrcache.hpp"
+#include "qrcodegen.hpp"
+
+// Portable image output for QR codes, shared by the GUI and by qrtool.
+namespace qrexport {
+
+// Renders a code as black on white, `scale` pixels per module with a `border`-module
+// quiet zone, and returns the RGBA PNG file bytes. Returns an empty vector on failure.
+[[nodiscard]]
+std::vector<unsigned char> encodePng(const qrcodegen::QrCode& qr, int scale, int border);
+
+// Renders a code as 8-bit greyscale pixels, 0 for dark and 255 for light, `scale` pixels per
+// module with a `border`-module quiet zone. The image is square, (size + 2 * border) * scale wide.
+[[nodiscard]]
+std::vector<unsigned char> renderGreyscale(const qrcodegen::QrCode& qr, int scale, int border);
+
+// Renders a serialised code the same way, straight from its record (e.g. in a mapped cache file).
+[[nodiscard]]
+std::vector<unsigned char> renderGreyscale(const qrcache::CodeView& qr, int scale, int border);
+
+// Renders a Micro QR Code the same way. Its quiet zone need only be 2 modules wide, half that of
+// a QR Code, which is the default border.
+[[nodiscard]]
+std::vector<unsigned char> renderGreyscale(const qrcodegen::MicroQrCode& qr, int scale,
+                                           int border = qrcodegen::MicroQrCode::QUIET_ZONE);
+
+// Source details an exported PNG can carry in text chunks, so that images can be indexed and
+// de-duplicated by reading chunk headers instead of decoding them. The hash is stored as 16
+// hex digits in a tEXt (or, when compressing, zTXt) chunk with keyword "QRTextFetch hash", the
+// payload as UTF-8 in an iTXt chunk with keyword "QRTextFetch payload".
+struct PngMetadata {
+    std::uint64_t payloadHash = 0;      // qrdelta::contentHash of the payload
+    std::string   payload;              // Empty to embed the hash alone
+};
+
+// Compresses a square image from renderGreyscale as a 1-bit greyscale PNG, the smallest PNG
+// form of a code. The colour mode is fixed, not auto-selected, so every image gets the same
+// IHDR. With metadata, adds its text chunks; payloads longer than a few hundred bytes are
+// compressed. Returns an empty vector on failure.
+[[nodiscard]]
+std::vector<unsigned char> encodeGreyscalePng(const std::vector<unsigned char>& image, unsigned side,
+                                              const PngMetadata* metadata = nullptr);
+
+// Reads the size and the metadata of a PNG file. Only the signature and chunk headers are read,
+// plus the IHDR and text chunks themselves; every other chunk, IDAT included, is skipped with a
+// seek, so no image data is read or inflated, and so are text chunks over 4 MiB or running past
+// the end of the file. The payload is filled in only if withPayload is set. Returns false if the
+// file cannot be read, is not a PNG or carries no payload hash.
+[[nodiscard]]
+bool readPngMetadata(const std::string& filename, bool withPayload, PngMetadata& metadata,
+                     unsigned& width, unsigned& height);
+
+// Renders a code like encodePng as an uncompressed 1-bit device-independent bitmap:
+// BITMAPINFOHEADER, a black and white palette, then bottom-up rows padded to 4 bytes.
+// This is the in-memory CF_DIB clipboard layout, so it can be handed to the clipboard
+// or to a viewer without any PNG or deflate step.
+[[nodiscard]]
+std::vector<unsigned char> encodeDib(const qrcodegen::QrCode& qr, int scale, int border);
+
+// encodeDib preceded by a BITMAPFILEHEADER: a .bmp file that any image viewer opens.
+// At one bit per pixel it stays small, and writing it costs little more than a copy.
+[[nodiscard]]
+std::vector<unsigned char> encodeBmp(const qrcodegen::QrCode& qr, int scale, int border);
+
+// Experimental colour multiplexing: renders three independent codes of the same size
+// into the R, G and B channels of one RGB PNG. A channel is 0 where its code has a dark
+// module, so a pixel is white where all three are light and black where all are dark.
+// Throws std::invalid_argument if the codes differ in size.
+[[nodiscard]]
+std::vector<unsigned char> encodeColorPng(const std::array<const qrcodegen::QrCode*, 3>& layers,
+                                          int scale, int border);
+
+// Receiving side of encodeColorPng: splits a colour PNG into three 8-bit greyscale PNGs,
+// one per channel in R, G, B order, each readable by an ordinary QR decoder.
+// Returns three empty vectors if the input cannot be decoded.
+[[nodiscard]]
+std::array<std::vector<unsigned char>, 3> splitColorPng(const std::vector<unsigned char>& png);
+
+// Recovers a size*size module grid (row-major, true = dark) from one channel of an
+// interleaved image with `channels` bytes per pixel, given the geometry it was rendered
+// with. Each module is read as the mean of its central pixels against a mid-grey threshold.
+[[nodiscard]]
+std::vector<bool> sampleModules(const std::vector<unsigned char>& pixels, unsigned width,
+                                int channels, int channel, int size, int scale, int border);
+
+// Returns the largest number of bytes that one byte-mode code of the given version
+// and level can hold. Throws std::invalid_argument for an out-of-range version.
+[[nodiscard]]
+std::size_t maxBytesPerCode(int version, qrcodegen::QrCode::Ecc ecc);
+
+// Splits UTF-8 text into consecutive parts that each fit one code of the given version
+// and level, cutting only between code points, and encodes every part at exactly that
+// version so that all codes have the same size. Empty text gives no codes.
+[[nodiscard]]
+std::vector<qrcodegen::QrCode> encodeParts(const std::string& text, int version, qrcodegen::QrCode::Ecc ecc);
+
+// Renders codes of the same size as the frames of one animated PNG (APNG) that loops
+// forever at the given frame rate (1 to 100 per second). Frames are rendered and
+// compressed in parallel, then written in order after the first frame's IHDR.
+// Viewers without APNG support show the first code. Returns an empty vector on failure;
+// throws std::invalid_argument if there are no codes, sizes differ or the rate is invalid.
+[[nodiscard]]
+std::vector<unsigned char> encodeApng(const std::vector<qrcodegen::QrCode>& frames, int scale, int border,
+                                      int framesPerSecond);
+
+// Renders many codes as one contact sheet: a grid of tiles, each holding one code and its
+// 1-based index as a caption underneath, written as a 1-bit greyscale PNG. Codes of different
+// sizes are centred in tiles sized for the largest one; a caption wider than its tile is left
+// out. `columns` <= 0 picks a near-square grid.
+// Grid rows are rendered in parallel straight into packed PNG scanlines, so no RGBA canvas is
+// built. Returns an empty vector on failure; throws std::invalid_argument if there are no codes.
+[[nodiscard]]
+std::vector<unsigned char> encodeContactSheet(const std::vector<qrcodegen::QrCode>& codes, int columns,
+                                              int scale, int border);
+
+// Page geometry for encodePdf, in PDF points (1/72 inch). The default is an A4 label sheet.
+struct PdfLayout {
+    double pageWidth   = 595.28;
+    double pageHeight  = 841.89;
+    double margin      = 28.35;    // 10 mm
+    double moduleSize  = 2.0;      // Printed size of one module
+    int    border      = 4;        // Quiet zone in modules around each code
+    bool   captions    = true;     // 1-based index under each code
+};
+
+// Renders codes as a vector PDF label sheet: codes of different sizes are centred in equal
+// tiles, filling each page left to right, top to bottom, as many pages as needed. Each code
+// is drawn as rectangles for runs of dark modules merged horizontally and then vertically,
+// in module units under one transform, so it prints sharp at any size. Page contents are
+// built and deflated in parallel, then written in order with their xref offsets recorded as
+// they go. Throws std::invalid_argument if there are no codes or not even one tile fits a page.
+[[nodiscard]]
+std::vector<unsigned char> encodePdf(const std::vector<qrcodegen::QrCode>& codes, const PdfLayout& layout);
+
+// How renderTerminal draws modules. Both set explicit black-on-white colours, so codes
+// scan the same on light and dark terminal themes.
+enum class TerminalStyle {
+    HalfBlocks,     // Two module rows per text line with the half block characters (UTF-8)
+    Background,     // One module row per line, two spaces per module on ANSI background colours
+};
+
+// Renders a code as text for a terminal with a `border`-module quiet zone; every line ends
+// with a colour reset and '\n'. The frame is built in one string sized up front, so it can be
+// written with a single call.
+[[nodiscard]]
+std::string renderTerminal(const qrcodegen::QrCode& qr, int border, TerminalStyle style);
+
+} // namespace qrexport
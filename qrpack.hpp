@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "qrcodegen.hpp"
+
+// Optional compress-before-encode step for short technical text (configs, shell commands,
+// logs). Payloads are plain zlib streams with a preset dictionary (FDICT) of tokens that are
+// common in such text, so even inputs of a few hundred bytes have history to match against.
+// The stream header names the dictionary by its Adler-32, so a packed payload is recognisable
+// and any zlib decoder given the same dictionary can read it.
+namespace qrpack {
+
+// Compresses UTF-8 (or any) text with the built-in dictionary. The result can be larger
+// than the input for text that shares little with the dictionary; callers compare sizes.
+[[nodiscard]]
+std::vector<std::uint8_t> compress(const std::string& text);
+
+// Whether a scanned payload is a zlib stream that uses the built-in dictionary.
+[[nodiscard]]
+bool isPacked(const std::vector<std::uint8_t>& payload) noexcept;
+
+// Receiving side of compress. Throws std::runtime_error if the payload is not a valid
+// stream for the built-in dictionary or fails its checksum.
+[[nodiscard]]
+std::string decompress(const std::vector<std::uint8_t>& payload);
+
+// Builds the segments for one code: the packed bytes when they need fewer bits than the
+// text itself (in its best plain segment modes), otherwise the plain text segments.
+[[nodiscard]]
+std::vector<qrcodegen::QrSegment> makeSegments(const std::string& text, bool* packed);
+
+} // namespace qrpack
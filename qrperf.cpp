@@ -0,0 +1,161 @@
+#include "qrperf.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace qrperf {
+
+namespace {
+
+constexpr const char* eventNames[numEvents] = {"cycles", "instructions", "L1d misses", "LLC misses", "branch misses"};
+
+#ifdef __linux__
+
+struct EventConfig {
+    std::uint32_t type;
+    std::uint64_t config;
+};
+
+constexpr EventConfig eventConfigs[numEvents] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                         | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+// Opens one disabled counter for the calling thread on any CPU, user mode only.
+[[nodiscard]]
+int openCounter(const EventConfig& event) noexcept {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof attr);
+    attr.size           = sizeof attr;
+    attr.type           = event.type;
+    attr.config         = event.config;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+#endif
+
+} // namespace
+
+const char* eventName(Event event) noexcept {
+    return eventNames[static_cast<std::size_t>(event)];
+}
+
+double Counts::ipc() const noexcept {
+    if (!has(Event::Cycles) || !has(Event::Instructions) || (*this)[Event::Cycles] == 0) {
+        return 0;
+    }
+    return static_cast<double>((*this)[Event::Instructions]) / static_cast<double>((*this)[Event::Cycles]);
+}
+
+Counts& Counts::operator+=(const Counts& other) noexcept {
+    for (std::size_t i = 0; i < numEvents; ++i) {
+        values[i] += other.values[i];
+        valid[i] = valid[i] || other.valid[i];
+    }
+    return *this;
+}
+
+#ifdef __linux__
+
+Counters::Counters() {
+    fds_.fill(-1);
+    std::string failed;
+    int error = 0;
+    for (std::size_t i = 0; i < numEvents; ++i) {
+        fds_[i] = openCounter(eventConfigs[i]);
+        if (fds_[i] < 0) {
+            error = errno;
+            failed += failed.empty() ? eventNames[i] : std::string(", ") + eventNames[i];
+        }
+    }
+    if (!failed.empty()) {
+        reason_ = "cannot count " + failed + ": " + std::strerror(error);
+        if (error == EACCES || error == EPERM) {
+            reason_ += " (see /proc/sys/kernel/perf_event_paranoid)";
+        }
+    }
+}
+
+Counters::~Counters() {
+    for (const int fd : fds_) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+bool Counters::available() const noexcept {
+    for (const int fd : fds_) {
+        if (fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Counters::start() noexcept {
+    for (const int fd : fds_) {
+        if (fd >= 0) {
+            (void)::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            (void)::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+Counts Counters::stop() noexcept {
+    for (const int fd : fds_) {
+        if (fd >= 0) {
+            (void)::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    Counts counts;
+    for (std::size_t i = 0; i < numEvents; ++i) {
+        std::uint64_t data[3];  // Value, time enabled, time running
+        if (fds_[i] < 0 || ::read(fds_[i], data, sizeof data) != static_cast<ssize_t>(sizeof data)) {
+            continue;
+        }
+        // A counter that shared its hardware with others ran only part of the time
+        counts.values[i] = data[2] != 0 && data[2] < data[1]
+            ? static_cast<std::uint64_t>(static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]))
+            : data[0];
+        counts.valid[i] = data[2] != 0;
+    }
+    return counts;
+}
+
+#else
+
+Counters::Counters()
+    : reason_{"hardware counters need Linux perf_event_open"} {
+    fds_.fill(-1);
+}
+
+Counters::~Counters() = default;
+
+bool Counters::available() const noexcept {
+    return false;
+}
+
+void Counters::start() noexcept {}
+
+Counts Counters::stop() noexcept {
+    return {};
+}
+
+#endif
+
+} // namespace qrperf
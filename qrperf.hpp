@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Hardware performance counters for the benchmarks, so that a slow stage can be told apart as
+// cache misses, branch mispredictions or plain instruction count rather than only timed.
+// Counting uses Linux perf_event_open for this thread in user mode only, which the default
+// perf_event_paranoid setting allows. Where that is not possible (other systems, containers
+// that forbid the call, virtual machines without a PMU), the counters report why and the
+// benchmarks carry on with timings alone.
+namespace qrperf {
+
+enum class Event {
+    Cycles,
+    Instructions,
+    L1dMisses,      // Level 1 data cache read misses
+    LlcMisses,      // Last level cache misses
+    BranchMisses,
+};
+
+constexpr std::size_t numEvents = 5;
+
+[[nodiscard]]
+const char* eventName(Event event) noexcept;
+
+// Event counts over one or more measured intervals. Counts are scaled up when the kernel had to
+// multiplex the counters, so they are estimates then.
+struct Counts {
+    std::array<std::uint64_t, numEvents> values{};
+    std::array<bool, numEvents>          valid{};    // Whether the event could be counted
+
+    [[nodiscard]]
+    bool has(Event event) const noexcept { return valid[static_cast<std::size_t>(event)]; }
+
+    [[nodiscard]]
+    std::uint64_t operator[](Event event) const noexcept { return values[static_cast<std::size_t>(event)]; }
+
+    // Instructions per cycle, or 0 unless both were counted.
+    [[nodiscard]]
+    double ipc() const noexcept;
+
+    Counts& operator+=(const Counts& other) noexcept;
+};
+
+// The counters of the calling thread. Opening never fails as such: events that cannot be
+// counted are left out and reason() says why. Only building that message can throw.
+class Counters final {
+public:
+    Counters();
+    ~Counters();
+    Counters(const Counters&) = delete;
+    Counters& operator=(const Counters&) = delete;
+
+    // Whether at least one event is counted.
+    [[nodiscard]]
+    bool available() const noexcept;
+
+    // Why some or all events are not counted; empty if all are.
+    [[nodiscard]]
+    const std::string& reason() const noexcept { return reason_; }
+
+    // Resets and starts the counters.
+    void start() noexcept;
+
+    // Stops the counters and returns the counts since start().
+    [[nodiscard]]
+    Counts stop() noexcept;
+
+private:
+    std::array<int, numEvents> fds_;
+    std::string                reason_;
+};
+
+} // namespace qrperf
@@ -0,0 +1,421 @@
+#include "qrsink.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include "lodepng.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace qrsink {
+
+namespace {
+
+// Files a writer thread takes per lock; enough to amortise the lock, few enough that the other
+// writers still get a share of a burst.
+constexpr std::size_t maxBatchFiles = 64;
+
+#ifdef _WIN32
+
+[[nodiscard]]
+bool writeAll(const std::filesystem::path& path, const std::vector<unsigned char>& data, bool flush) {
+    HANDLE h = ::CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    bool ok = true;
+    for (std::size_t done = 0; ok && done < data.size(); ) {
+        DWORD written = 0;
+        const DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(data.size() - done, 1u << 30));
+        ok = ::WriteFile(h, data.data() + done, chunk, &written, nullptr) != 0;
+        done += written;
+    }
+    if (ok && flush) {
+        ok = ::FlushFileBuffers(h) != 0;
+    }
+    return ::CloseHandle(h) != 0 && ok;
+}
+
+// NTFS journals directory changes itself and a directory cannot be flushed like a file
+void syncDirectory(const std::filesystem::path&) noexcept {}
+
+#else
+
+[[nodiscard]]
+bool writeAll(const std::filesystem::path& path, const std::vector<unsigned char>& data, bool flush) {
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = true;
+    for (std::size_t done = 0; ok && done < data.size(); ) {
+        const ssize_t written = ::write(fd, data.data() + done, data.size() - done);
+        ok = written > 0;
+        done += ok ? static_cast<std::size_t>(written) : 0;
+    }
+    if (ok && flush) {
+        ok = ::fsync(fd) == 0;
+    }
+    return ::close(fd) == 0 && ok;
+}
+
+void syncDirectory(const std::filesystem::path& directory) noexcept {
+    const int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        (void)::fsync(fd);
+        ::close(fd);
+    }
+}
+
+#endif
+
+constexpr std::size_t archiveBufferSize = std::size_t{1} << 20;
+
+void putLe16(std::vector<unsigned char>& out, std::uint32_t value) {
+    out.push_back(static_cast<unsigned char>(value));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+void putLe32(std::vector<unsigned char>& out, std::uint32_t value) {
+    putLe16(out, value & 0xFFFF);
+    putLe16(out, value >> 16);
+}
+
+void putLe64(std::vector<unsigned char>& out, std::uint64_t value) {
+    putLe32(out, static_cast<std::uint32_t>(value));
+    putLe32(out, static_cast<std::uint32_t>(value >> 32));
+}
+
+// Current local time as MS-DOS date (high half) and time (low half), as ZIP headers record it.
+[[nodiscard]]
+std::uint32_t dosTimeNow() {
+    const std::time_t now = std::time(nullptr);
+    const std::tm* t = std::localtime(&now);
+    if (!t || t->tm_year < 80) {
+        return (1u << 21) | (1u << 16);  // 1980-01-01
+    }
+    const std::uint32_t date = (static_cast<std::uint32_t>(t->tm_year - 80) << 9)
+                             | (static_cast<std::uint32_t>(t->tm_mon + 1) << 5) | static_cast<std::uint32_t>(t->tm_mday);
+    const std::uint32_t time = (static_cast<std::uint32_t>(t->tm_hour) << 11)
+                             | (static_cast<std::uint32_t>(t->tm_min) << 5) | static_cast<std::uint32_t>(t->tm_sec / 2);
+    return (date << 16) | time;
+}
+
+// Writes `value` as a zero-padded octal field of `width` bytes, the last one NUL.
+[[nodiscard]]
+bool putOctal(unsigned char* field, std::size_t width, std::uint64_t value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%0*" PRIo64, static_cast<int>(width - 1), value);
+    if (std::strlen(text) != width - 1) {
+        return false;
+    }
+    std::memcpy(field, text, width);
+    return true;
+}
+
+} // namespace
+
+AsyncFileWriter::AsyncFileWriter(unsigned threads, SyncPolicy sync, std::size_t maxQueuedBytes)
+    : sync_{sync}
+    , maxQueuedBytes_{std::max<std::size_t>(maxQueuedBytes, 1)} {
+    for (unsigned i = 0; i < std::max(threads, 1u); ++i) {
+        threads_.emplace_back([this] { run(); });
+    }
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    (void)finish();
+}
+
+void AsyncFileWriter::write(std::filesystem::path path, std::vector<unsigned char> data) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // An empty queue always takes the file, however large, so that one big file cannot deadlock
+    notFull_.wait(lock, [this] { return queue_.empty() || queuedBytes_ < maxQueuedBytes_; });
+    if (sync_ == SyncPolicy::Full) {
+        std::filesystem::path parent = path.parent_path();
+        if (std::find(directories_.begin(), directories_.end(), parent) == directories_.end()) {
+            directories_.push_back(std::move(parent));
+        }
+    }
+    queuedBytes_ += data.size();
+    queue_.emplace_back(std::move(path), std::move(data));
+    lock.unlock();
+    notEmpty_.notify_one();
+}
+
+WriterStats AsyncFileWriter::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    notEmpty_.notify_all();
+    for (auto& t : threads_) {
+        t.join();
+    }
+    threads_.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& directory : directories_) {
+        syncDirectory(directory);
+    }
+    directories_.clear();
+    return stats_;
+}
+
+void AsyncFileWriter::run() {
+    std::vector<File> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            notEmpty_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;  // Stopping and drained
+            }
+            const std::size_t count = std::min(queue_.size(), maxBatchFiles);
+            for (std::size_t i = 0; i < count; ++i) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+            ++stats_.batches;
+        }
+
+        std::size_t written = 0, failed = 0;
+        std::uint64_t bytes = 0, released = 0;
+        for (const File& file : batch) {
+            released += file.second.size();
+            if (writeOne(file)) {
+                ++written;
+                bytes += file.second.size();
+            } else {
+                ++failed;
+            }
+        }
+        batch.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queuedBytes_ -= static_cast<std::size_t>(released);
+            stats_.files  += written;
+            stats_.failed += failed;
+            stats_.bytes  += bytes;
+        }
+        notFull_.notify_all();
+    }
+}
+
+bool AsyncFileWriter::writeOne(const File& file) const {
+    return writeAll(file.first, file.second, sync_ != SyncPolicy::None);
+}
+
+ArchiveWriter::ArchiveWriter(const std::filesystem::path& path, ArchiveFormat format,
+                             const std::filesystem::path& indexPath)
+    : format_{format}
+    , buffer_(archiveBufferSize) {
+    // Entries are small, so write through one large buffer rather than a call per header
+    out_.rdbuf()->pubsetbuf(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    out_.open(path, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        throw std::runtime_error("Cannot create " + path.string());
+    }
+    if (!indexPath.empty()) {
+        index_.open(indexPath, std::ios::trunc);
+        if (!index_) {
+            throw std::runtime_error("Cannot create " + indexPath.string());
+        }
+    }
+    modified_ = format_ == ArchiveFormat::Zip ? dosTimeNow() : static_cast<std::uint32_t>(std::time(nullptr));
+}
+
+ArchiveWriter::~ArchiveWriter() {
+    try {
+        finish();
+    }
+    catch (...) {
+    }
+}
+
+void ArchiveWriter::add(const std::string& name, const std::vector<unsigned char>& data, std::uint64_t payloadHash) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_) {
+        throw std::logic_error("Archive already finished");
+    }
+    const std::uint64_t dataOffset = format_ == ArchiveFormat::Zip ? addZip(name, data) : addTar(name, data);
+    if (index_.is_open()) {
+        char line[64];
+        std::snprintf(line, sizeof(line), "%016" PRIx64 " %" PRIu64 " %zu ", payloadHash, dataOffset, data.size());
+        index_ << line << name << '\n';
+    }
+}
+
+void ArchiveWriter::finish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_) {
+        return;
+    }
+    finished_ = true;
+    if (format_ == ArchiveFormat::Zip) {
+        finishZip();
+    } else {
+        // Two zero blocks end a tar archive
+        static constexpr unsigned char zeros[1024] = {};
+        append(zeros, sizeof(zeros));
+    }
+    out_.close();
+    if (out_.fail()) {
+        throw std::runtime_error("Cannot write archive");
+    }
+    if (index_.is_open()) {
+        index_.close();
+        if (index_.fail()) {
+            throw std::runtime_error("Cannot write archive index");
+        }
+    }
+}
+
+void ArchiveWriter::append(const unsigned char* data, std::size_t size) {
+    out_.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+    if (!out_) {
+        throw std::runtime_error("Cannot write archive");
+    }
+    offset_ += size;
+}
+
+std::uint64_t ArchiveWriter::addZip(const std::string& name, const std::vector<unsigned char>& data) {
+    if (name.size() > 0xFFFF) {
+        throw std::length_error("Entry name too long for ZIP");
+    }
+    if (offset_ + 30 + name.size() + data.size() > 0xFFFFFFFFu) {
+        throw std::length_error("ZIP archive would exceed 4 GiB; use tar");
+    }
+    const Entry entry{name, lodepng_crc32(data.data(), data.size()),
+                      static_cast<std::uint32_t>(data.size()), static_cast<std::uint32_t>(offset_)};
+
+    std::vector<unsigned char> header;
+    header.reserve(30 + name.size());
+    putLe32(header, 0x04034B50);    // Local file header signature
+    putLe16(header, 10);            // Version needed: 1.0, stored
+    putLe16(header, 0);             // Flags
+    putLe16(header, 0);             // Method: stored
+    putLe32(header, modified_);
+    putLe32(header, entry.crc);
+    putLe32(header, entry.size);    // Compressed size
+    putLe32(header, entry.size);    // Uncompressed size
+    putLe16(header, static_cast<std::uint32_t>(name.size()));
+    putLe16(header, 0);             // Extra field length
+    header.insert(header.end(), name.begin(), name.end());
+    append(header.data(), header.size());
+    const std::uint64_t dataOffset = offset_;
+    append(data.data(), data.size());
+    entries_.push_back(entry);
+    return dataOffset;
+}
+
+void ArchiveWriter::finishZip() {
+    const std::uint64_t directoryOffset = offset_;
+    std::vector<unsigned char> record;
+    for (const Entry& entry : entries_) {
+        record.clear();
+        putLe32(record, 0x02014B50);    // Central directory header signature
+        putLe16(record, 20);            // Made by: MS-DOS attributes, spec 2.0
+        putLe16(record, 10);            // Version needed
+        putLe16(record, 0);             // Flags
+        putLe16(record, 0);             // Method: stored
+        putLe32(record, modified_);
+        putLe32(record, entry.crc);
+        putLe32(record, entry.size);
+        putLe32(record, entry.size);
+        putLe16(record, static_cast<std::uint32_t>(entry.name.size()));
+        putLe16(record, 0);             // Extra field length
+        putLe16(record, 0);             // Comment length
+        putLe16(record, 0);             // Disk number
+        putLe16(record, 0);             // Internal attributes
+        putLe32(record, 0);             // External attributes
+        putLe32(record, entry.headerOffset);
+        record.insert(record.end(), entry.name.begin(), entry.name.end());
+        append(record.data(), record.size());
+    }
+    const std::uint64_t directorySize = offset_ - directoryOffset;
+    if (offset_ > 0xFFFFFFFFu) {
+        throw std::length_error("ZIP archive would exceed 4 GiB; use tar");
+    }
+
+    record.clear();
+    const bool zip64 = entries_.size() > 0xFFFF;
+    if (zip64) {
+        // The 16-bit entry counts overflow: add a ZIP64 end record and its locator
+        const std::uint64_t zip64Offset = offset_;
+        putLe32(record, 0x06064B50);
+        putLe64(record, 44);            // Size of the rest of this record
+        putLe16(record, 45);            // Made by: spec 4.5 (ZIP64)
+        putLe16(record, 45);            // Version needed
+        putLe32(record, 0);             // This disk
+        putLe32(record, 0);             // Disk with the central directory
+        putLe64(record, entries_.size());
+        putLe64(record, entries_.size());
+        putLe64(record, directorySize);
+        putLe64(record, directoryOffset);
+        putLe32(record, 0x07064B50);    // ZIP64 end locator
+        putLe32(record, 0);             // Disk with the ZIP64 end record
+        putLe64(record, zip64Offset);
+        putLe32(record, 1);             // Total disks
+    }
+    const std::uint32_t count = zip64 ? 0xFFFF : static_cast<std::uint32_t>(entries_.size());
+    putLe32(record, 0x06054B50);        // End of central directory signature
+    putLe16(record, 0);                 // This disk
+    putLe16(record, 0);                 // Disk with the central directory
+    putLe16(record, count);
+    putLe16(record, count);
+    putLe32(record, static_cast<std::uint32_t>(directorySize));
+    putLe32(record, static_cast<std::uint32_t>(directoryOffset));
+    putLe16(record, 0);                 // Comment length
+    append(record.data(), record.size());
+}
+
+std::uint64_t ArchiveWriter::addTar(const std::string& name, const std::vector<unsigned char>& data) {
+    if (name.size() > 100) {
+        throw std::length_error("Entry name too long for tar");
+    }
+    unsigned char header[512] = {};
+    std::memcpy(header, name.data(), name.size());
+    bool ok = putOctal(header + 100, 8, 0644)                   // Mode
+           && putOctal(header + 108, 8, 0)                      // Owner
+           && putOctal(header + 116, 8, 0)                      // Group
+           && putOctal(header + 124, 12, data.size())
+           && putOctal(header + 136, 12, modified_);
+    if (!ok) {
+        throw std::length_error("Entry too large for tar");
+    }
+    header[156] = '0';                                          // Regular file
+    std::memcpy(header + 257, "ustar", 6);
+    std::memcpy(header + 263, "00", 2);
+
+    // The checksum is the byte sum of the header with its own field read as spaces
+    std::memset(header + 148, ' ', 8);
+    unsigned checksum = 0;
+    for (const unsigned char byte : header) {
+        checksum += byte;
+    }
+    (void)putOctal(header + 148, 7, checksum);
+    header[155] = ' ';
+
+    append(header, sizeof(header));
+    const std::uint64_t dataOffset = offset_;
+    append(data.data(), data.size());
+    static constexpr unsigned char padding[512] = {};
+    append(padding, (512 - data.size() % 512) % 512);
+    entries_.push_back(Entry{name, 0, 0, 0});
+    return dataOffset;
+}
+
+} // namespace qrsink
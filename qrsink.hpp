@@ -0,0 +1,147 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Output sinks for batch runs, which produce thousands of small images faster than writing them
+// one blocking open, write and close at a time keeps up with.
+namespace qrsink {
+
+// How hard AsyncFileWriter works to make files durable before reporting them written.
+enum class SyncPolicy {
+    None,       // Leave flushing to the operating system
+    Files,      // Flush each file to the device before closing it
+    Full,       // Files, and on POSIX systems also each output directory once at the end,
+                // so that the new directory entries survive a crash too
+};
+
+struct WriterStats {
+    std::size_t   files   = 0;    // Files written successfully
+    std::size_t   failed  = 0;    // Files that could not be created or written
+    std::size_t   batches = 0;    // Times a writer thread took queued files
+    std::uint64_t bytes   = 0;
+};
+
+// Writes files on background threads so that the producing threads only hand buffers over.
+// Buffers are moved in, not copied. Each writer thread takes every queued file at once (up to a
+// batch limit) under one lock and writes them with the platform's unbuffered calls, so the
+// queue lock is taken once per batch rather than once per file. When the queued bytes exceed
+// the limit, write() blocks until the writers catch up, which bounds memory.
+class AsyncFileWriter final {
+public:
+    explicit AsyncFileWriter(unsigned threads = 2, SyncPolicy sync = SyncPolicy::None,
+                             std::size_t maxQueuedBytes = std::size_t{64} << 20);
+    // Finishes outstanding writes.
+    ~AsyncFileWriter();
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    // Queues a file to be created (or replaced) with the given contents. Thread safe.
+    void write(std::filesystem::path path, std::vector<unsigned char> data);
+
+    // Waits until every queued file is written, syncs directories under SyncPolicy::Full, stops
+    // the writer threads and returns the totals. Later calls return the same totals.
+    WriterStats finish();
+
+private:
+    using File = std::pair<std::filesystem::path, std::vector<unsigned char>>;
+
+    SyncPolicy  sync_;
+    std::size_t maxQueuedBytes_;
+
+    std::mutex              mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<File>        queue_;
+    std::size_t             queuedBytes_ = 0;
+    bool                    stopping_    = false;
+    WriterStats             stats_;
+    std::vector<std::filesystem::path> directories_;   // Distinct parents, for SyncPolicy::Full
+
+    std::vector<std::thread> threads_;
+
+    void run();
+
+    // Creates, writes and (per policy) syncs one file; returns false on any failure.
+    [[nodiscard]]
+    bool writeOne(const File& file) const;
+};
+
+enum class ArchiveFormat {
+    Zip,    // Stored entries: PNG data is deflated already, so compressing again gains nothing
+    Tar,    // POSIX ustar
+};
+
+// Streams many files into one archive, so that a batch costs one file's metadata instead of
+// one per image. Each entry is written as soon as it is added (its CRC-32 for ZIP computed
+// with lodepng_crc32 first); a ZIP gets its central directory, and a tar its end-of-archive
+// blocks, from finish(). With more than 65535 entries a ZIP gets a ZIP64 end record; offsets
+// beyond 4 GiB are not supported in ZIP, for which tar is the format.
+//
+// The optional sidecar index is a text file with one line per entry:
+//     <payload hash, 16 hex digits> <offset of the data> <size> <name>
+// Entries are stored uncompressed in both formats, so a reader can seek straight to the
+// bytes of an image by payload hash without parsing the archive.
+class ArchiveWriter final {
+public:
+    // Creates the archive and, unless indexPath is empty, the index. Throws std::runtime_error
+    // if either cannot be created.
+    ArchiveWriter(const std::filesystem::path& path, ArchiveFormat format,
+                  const std::filesystem::path& indexPath = {});
+    // Finishes the archive if finish() was not called, ignoring errors.
+    ~ArchiveWriter();
+    ArchiveWriter(const ArchiveWriter&) = delete;
+    ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+    // Appends one entry. Thread safe; entries are written in the order of the calls. Throws
+    // std::runtime_error if writing fails, or std::length_error if the name or size exceeds
+    // what the format can record.
+    void add(const std::string& name, const std::vector<unsigned char>& data, std::uint64_t payloadHash = 0);
+
+    // Writes the trailing structures and closes the files. Throws std::runtime_error on failure.
+    void finish();
+
+    [[nodiscard]]
+    std::size_t entries() const noexcept { return entries_.size(); }
+
+    // Bytes written to the archive so far, headers included.
+    [[nodiscard]]
+    std::uint64_t size() const noexcept { return offset_; }
+
+private:
+    struct Entry {
+        std::string   name;
+        std::uint32_t crc;
+        std::uint32_t size;
+        std::uint32_t headerOffset;
+    };
+
+    ArchiveFormat      format_;
+    std::ofstream      out_;
+    std::ofstream      index_;
+    std::vector<char>  buffer_;
+    std::mutex         mutex_;
+    std::vector<Entry> entries_;
+    std::uint64_t      offset_   = 0;
+    std::uint32_t      modified_ = 0;     // DOS date and time (ZIP) or Unix time (tar) of creation
+    bool               finished_ = false;
+
+    void append(const unsigned char* data, std::size_t size);
+
+    // Write one entry and return the archive offset of its data.
+    std::uint64_t addZip(const std::string& name, const std::vector<unsigned char>& data);
+    std::uint64_t addTar(const std::string& name, const std::vector<unsigned char>& data);
+
+    void finishZip();
+};
+
+} // namespace qrsink
@@ -0,0 +1,1638 @@
+// Portable command-line companion to QRTextFetch: the receiving-side utilities
+// and benchmarks that do not need the Win32 GUI.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#endif
+
+#include "qrbatch.hpp"
+#include "qrcache.hpp"
+#include "qrcodegen.hpp"
+#include "qrcodegen_fixed.hpp"
+#include "qrcost.hpp"
+#include "qrdelta.hpp"
+#include "qrexport.hpp"
+#include "qrpack.hpp"
+#include "qrperf.hpp"
+#include "qrsink.hpp"
+#include "lodepng.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+[[nodiscard]]
+double elapsedMicros(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+[[nodiscard]]
+bool readFile(const std::string& filename, std::vector<unsigned char>& data) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !in.bad();
+}
+
+[[nodiscard]]
+bool writeFile(const std::string& filename, const std::vector<unsigned char>& data) {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(out);
+}
+
+// split-rgb <colour.png> <prefix>: writes <prefix>-r.png, -g.png and -b.png.
+int runSplitRgb(int argc, char* argv[]) {
+    if (argc != 2) {
+        return 2;
+    }
+    std::vector<unsigned char> png;
+    if (!readFile(argv[0], png)) {
+        std::fprintf(stderr, "Cannot read %s\n", argv[0]);
+        return 1;
+    }
+
+    const auto layers = qrexport::splitColorPng(png);
+    if (layers[0].empty()) {
+        std::fprintf(stderr, "%s is not a decodable PNG\n", argv[0]);
+        return 1;
+    }
+    static constexpr const char* suffixes[] = {"-r.png", "-g.png", "-b.png"};
+    for (std::size_t i = 0; i < layers.size(); ++i) {
+        const std::string filename = std::string(argv[1]) + suffixes[i];
+        if (!writeFile(filename, layers[i])) {
+            std::fprintf(stderr, "Cannot write %s\n", filename.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// apng <out.png> [fps] [version]: splits standard input into codes of one version
+// (default 20, level M) and writes them as the frames of a looping animated PNG.
+int runApng(int argc, char* argv[]) {
+    if (argc < 1 || argc > 3) {
+        return 2;
+    }
+    const int framesPerSecond = argc > 1 ? std::atoi(argv[1]) : 2;
+    const int version         = argc > 2 ? std::atoi(argv[2]) : 20;
+    const std::string text{std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()};
+
+    try {
+        const auto codes = qrexport::encodeParts(text, version, qrcodegen::QrCode::Ecc::MEDIUM);
+        if (codes.empty()) {
+            std::fprintf(stderr, "No input text\n");
+            return 1;
+        }
+        const auto png = qrexport::encodeApng(codes, 4, 4, framesPerSecond);
+        if (png.empty() || !writeFile(argv[0], png)) {
+            std::fprintf(stderr, "Cannot write %s\n", argv[0]);
+            return 1;
+        }
+        std::fprintf(stderr, "%zu frames, %zu bytes\n", codes.size(), png.size());
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
+
+// sheet <out.png> [columns] [scale]: encodes each line of standard input as one code (level M)
+// and tiles them into a captioned contact sheet.
+int runSheet(int argc, char* argv[]) {
+    if (argc < 1 || argc > 3) {
+        return 2;
+    }
+    const int columns = argc > 1 ? std::atoi(argv[1]) : 0;
+    const int scale   = argc > 2 ? std::atoi(argv[2]) : 4;
+    if (scale <= 0) {
+        return 2;
+    }
+
+    try {
+        std::vector<qrcodegen::QrCode> codes;
+        for (std::string line; std::getline(std::cin, line); ) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            codes.push_back(qrcodegen::QrCode::encodeText(line.c_str(), qrcodegen::QrCode::Ecc::MEDIUM));
+        }
+        if (codes.empty()) {
+            std::fprintf(stderr, "No input lines\n");
+            return 1;
+        }
+        const auto start = Clock::now();
+        const auto png = qrexport::encodeContactSheet(codes, columns, scale, 4);
+        const double micros = elapsedMicros(start);
+        if (png.empty() || !writeFile(argv[0], png)) {
+            std::fprintf(stderr, "Cannot write %s\n", argv[0]);
+            return 1;
+        }
+        std::fprintf(stderr, "%zu codes, %zu bytes, %.2f ms\n", codes.size(), png.size(), micros / 1000);
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
+
+// pack <out.png> [--stats]: encodes standard input as one code (level M), compressed with the
+// preset dictionary when that makes it smaller. --stats also reports the plain encoding.
+int runPack(int argc, char* argv[]) {
+    if (argc < 1 || argc > 2 || (argc == 2 && std::strcmp(argv[1], "--stats") != 0)) {
+        return 2;
+    }
+    const std::string text{std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()};
+    if (text.empty()) {
+        std::fprintf(stderr, "No input text\n");
+        return 1;
+    }
+
+    try {
+        constexpr auto ecc = qrcodegen::QrCode::Ecc::MEDIUM;
+        bool packed = false;
+        const auto qr = qrcodegen::QrCode::encodeSegments(qrpack::makeSegments(text, &packed), ecc);
+        const auto png = qrexport::encodePng(qr, 4, 4);
+        if (png.empty() || !writeFile(argv[0], png)) {
+            std::fprintf(stderr, "Cannot write %s\n", argv[0]);
+            return 1;
+        }
+        std::fprintf(stderr, "%zu bytes of text, %s, version %d\n", text.size(),
+                     packed ? "packed" : "plain", qr.getVersion());
+        if (argc == 2) {
+            const std::size_t packedSize = qrpack::compress(text).size();
+            const auto plainQr = qrcodegen::QrCode::encodeText(text.c_str(), ecc);
+            std::fprintf(stderr, "packed payload %zu bytes (%.0f%% of text); plain text alone needs version %d\n",
+                         packedSize, 100.0 * static_cast<double>(packedSize) / static_cast<double>(text.size()),
+                         plainQr.getVersion());
+        }
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
+
+// Reads the codeword bits of a Micro QR Code back from its modules, as a decoder would: removes
+// the mask and walks the data area in placement order. Written from the symbol layout of
+// ISO/IEC 18004 rather than shared with the encoder, so that it checks the placement too. The
+// bits are packed 8 to a byte, so M1 and M3, whose last data codeword has 4 bits, come out shifted.
+[[nodiscard]]
+std::vector<std::uint8_t> readMicroCodewords(const qrcodegen::MicroQrCode& qr) {
+    const int size = qr.getSize();
+    std::vector<std::uint8_t> result;
+    int bits = 0;
+    bool upward = true;
+    for (int right = size - 1; right >= 1; right -= 2, upward = !upward) {
+        for (int vert = 0; vert < size; ++vert) {
+            for (int x = right; x >= right - 1; --x) {
+                const int y = upward ? size - 1 - vert : vert;
+                // Finder, separator and format area in the corner, timing patterns along the edges
+                if ((x <= 8 && y <= 8) || x == 0 || y == 0) {
+                    continue;
+                }
+                bool invert = false;
+                switch (qr.getMask()) {
+                    case 0:  invert = y % 2 == 0;                          break;
+                    case 1:  invert = (x / 3 + y / 2) % 2 == 0;            break;
+                    case 2:  invert = (x * y % 2 + x * y % 3) % 2 == 0;    break;
+                    default: invert = ((x + y) % 2 + x * y % 3) % 2 == 0;  break;
+                }
+                if (bits % 8 == 0) {
+                    result.push_back(0);
+                }
+                result.back() |= static_cast<std::uint8_t>((qr.getModule(x, y) != invert ? 1 : 0) << (7 - bits % 8));
+                ++bits;
+            }
+        }
+    }
+    return result;
+}
+
+// Encodes the Micro QR example of ISO/IEC 18004 Annex I, "01234567" as M2-L, and compares its
+// codewords with those printed there. Returns false and says what differs if they do not match.
+[[nodiscard]]
+bool checkMicroAnnexExample() {
+    constexpr std::uint8_t expected[] = {0x40, 0x18, 0xAC, 0xC3, 0x00,   // Data
+                                         0x86, 0x0D, 0x22, 0xAE, 0x30};  // Error correction
+    const auto qr = qrcodegen::MicroQrCode::encodeSegments(qrcodegen::QrSegment::makeSegments("01234567"),
+        qrcodegen::QrCode::Ecc::LOW, qrcodegen::MicroQrCode::MIN_VERSION, qrcodegen::MicroQrCode::MAX_VERSION, -1, false);
+    if (qr.getVersion() != 2 || qr.getErrorCorrectionLevel() != qrcodegen::QrCode::Ecc::LOW) {
+        std::fprintf(stderr, "Annex example encoded as M%d-%c, not M2-L\n", qr.getVersion(),
+                     "LMQH"[static_cast<int>(qr.getErrorCorrectionLevel())]);
+        return false;
+    }
+    const auto codewords = readMicroCodewords(qr);
+    const bool same = codewords.size() == std::size(expected)
+                   && std::equal(codewords.begin(), codewords.end(), std::begin(expected));
+    std::printf("M2-L \"01234567\", mask %d:", qr.getMask());
+    for (const std::uint8_t b : codewords) {
+        std::printf(" %02X", b);
+    }
+    std::printf("\n%s ISO/IEC 18004 Annex I\n", same ? "matches" : "differs from");
+    return same;
+}
+
+// micro <out.png> [scale] | micro --check: encodes standard input, less a final line break, as
+// the smallest Micro QR Code (level L, raised where that keeps the version) and writes it with
+// the 2-module quiet zone, `scale` pixels per module (default 8). --check instead verifies the
+// codewords of the ISO/IEC 18004 Annex I example.
+int runMicro(int argc, char* argv[]) {
+    if (argc == 1 && std::strcmp(argv[0], "--check") == 0) {
+        return checkMicroAnnexExample() ? 0 : 1;
+    }
+    if (argc < 1 || argc > 2) {
+        return 2;
+    }
+    const int scale = argc > 1 ? std::atoi(argv[1]) : 8;
+    if (scale <= 0) {
+        return 2;
+    }
+    std::string text{std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()};
+    if (!text.empty() && text.back() == '\n') {
+        text.pop_back();
+        if (!text.empty() && text.back() == '\r') {
+            text.pop_back();
+        }
+    }
+
+    try {
+        const auto qr = qrcodegen::MicroQrCode::encodeText(text.c_str(), qrcodegen::QrCode::Ecc::LOW);
+        const unsigned side = static_cast<unsigned>((qr.getSize() + qrcodegen::MicroQrCode::QUIET_ZONE * 2) * scale);
+        const auto png = qrexport::encodeGreyscalePng(qrexport::renderGreyscale(qr, scale), side);
+        if (png.empty() || !writeFile(argv[0], png)) {
+            std::fprintf(stderr, "Cannot write %s\n", argv[0]);
+            return 1;
+        }
+        std::fprintf(stderr, "%zu bytes of text, M%d-%c, mask %d, %u pixels square\n", text.size(), qr.getVersion(),
+                     "LMQH"[static_cast<int>(qr.getErrorCorrectionLevel())], qr.getMask(), side);
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
+
+// unpack <payload-file> [out]: restores the text of a scanned payload saved as raw bytes.
+// Payloads that are not packed are passed through unchanged.
+int runUnpack(int argc, char* argv[]) {
+    if (argc < 1 || argc > 2) {
+        return 2;
+    }
+    std::vector<unsigned char> payload;
+    if (!readFile(argv[0], payload)) {
+        std::fprintf(stderr, "Cannot read %s\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<unsigned char> text = payload;
+    if (qrpack::isPacked(payload)) {
+        try {
+            const std::string unpacked = qrpack::decompress(payload);
+            text.assign(unpacked.begin(), unpacked.end());
+        }
+        catch (const std::exception& e) {
+            std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+            return 1;
+        }
+    }
+
+    if (argc == 2) {
+        if (!writeFile(argv[1], text)) {
+            std::fprintf(stderr, "Cannot write %s\n", argv[1]);
+            return 1;
+        }
+        return 0;
+    }
+    std::fwrite(text.data(), 1, text.size(), stdout);
+    return 0;
+}
+
+// delta <out.png>: encodes standard input as one code (level M). If the delta history holds an
+// earlier revision that makes a smaller diff, only the diff is encoded (compressed when that
+// helps). The text is then added to the history as a base for later deltas.
+int runDelta(int argc, char* argv[]) {
+    if (argc != 1) {
+        return 2;
+    }
+    const std::string text{std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()};
+    if (text.empty()) {
+        std::fprintf(stderr, "No input text\n");
+        return 1;
+    }
+
+    try {
+        qrdelta::History history(qrdelta::History::defaultDirectory());
+        std::vector<std::uint8_t> delta = history.bestDelta(text);
+        std::vector<qrcodegen::QrSegment> segs;
+        bool packed = false;
+        if (delta.empty()) {
+            segs = qrpack::makeSegments(text, &packed);
+        } else {
+            std::vector<std::uint8_t> compressed = qrpack::compress(std::string(delta.begin(), delta.end()));
+            packed = compressed.size() < delta.size();
+            segs.push_back(qrcodegen::QrSegment::makeBytes(packed ? compressed : delta));
+        }
+
+        const auto qr = qrcodegen::QrCode::encodeSegments(segs, qrcodegen::QrCode::Ecc::MEDIUM);
+        const auto png = qrexport::encodePng(qr, 4, 4);
+        if (png.empty() || !writeFile(argv[0], png)) {
+            std::fprintf(stderr, "Cannot write %s\n", argv[0]);
+            return 1;
+        }
+        if (!history.store(text)) {
+            std::fprintf(stderr, "Warning: cannot store the revision in the delta history\n");
+        }
+        std::fprintf(stderr, "%zu bytes of text, %s%s, version %d\n", text.size(),
+                     delta.empty() ? "full text" : "delta", packed ? " (packed)" : "", qr.getVersion());
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
+
+// apply <payload-file> [out]: receiving side of delta. Restores the text of a scanned payload
+// (full, packed or delta against a revision in the local history) and records it as a
+// revision, so that later deltas against it can be applied.
+int runApply(int argc, char* argv[]) {
+    if (argc < 1 || argc > 2) {
+        return 2;
+    }
+    std::vector<unsigned char> payload;
+    if (!readFile(argv[0], payload)) {
+        std::fprintf(stderr, "Cannot read %s\n", argv[0]);
+        return 1;
+    }
+
+    try {
+        if (qrpack::isPacked(payload)) {
+            const std::string unpacked = qrpack::decompress(payload);
+            payload.assign(unpacked.begin(), unpacked.end());
+        }
+
+        qrdelta::History history(qrdelta::History::defaultDirectory());
+        std::string text;
+        if (qrdelta::isDelta(payload)) {
+            std::string base;
+            if (!history.load(qrdelta::baseHash(payload), base)) {
+                std::fprintf(stderr, "%s: base revision %016llx is not in the history\n", argv[0],
+                             static_cast<unsigned long long>(qrdelta::baseHash(payload)));
+                return 1;
+            }
+            text = qrdelta::applyDelta(base, payload);
+        } else {
+            text.assign(payload.begin(), payload.end());
+        }
+        if (!history.store(text)) {
+            std::fprintf(stderr, "Warning: cannot store the revision in the delta history\n");
+        }
+
+        if (argc == 2) {
+            if (!writeFile(argv[1], std::vector<unsigned char>(text.begin(), text.end()))) {
+                std::fprintf(stderr, "Cannot write %s\n", argv[1]);
+                return 1;
+            }
+            return 0;
+        }
+        std::fwrite(text.data(), 1, text.size(), stdout);
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+        return 1;
+    }
+}
+
+// Prepares the console for renderTerminal output: UTF-8 and ANSI escapes are opt-in on Windows.
+void enableTerminalOutput() {
+#ifdef _WIN32
+    ::SetConsoleOutputCP(CP_UTF8);
+    HANDLE console = ::GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    if (console != INVALID_HANDLE_VALUE && ::GetConsoleMode(console, &mode)) {
+        ::SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    }
+#endif
+}
+
+// term [--ansi] [seconds] [rounds]: shows standard input as a code on the terminal, for servers
+// without an image viewer. Text too long for one code is split into version 10 codes (level M),
+// shown in turn for `seconds` each (default 2) and redrawn in place; `rounds` limits the
+// cycles through all parts (default 0, until interrupted).
+int runTerm(int argc, char* argv[]) {
+    auto style = qrexport::TerminalStyle::HalfBlocks;
+    if (argc > 0 && std::strcmp(argv[0], "--ansi") == 0) {
+        style = qrexport::TerminalStyle::Background;
+        ++argv;
+        --argc;
+    }
+    if (argc > 2) {
+        return 2;
+    }
+    const double seconds = argc > 0 ? std::atof(argv[0]) : 2.0;
+    const int rounds     = argc > 1 ? std::atoi(argv[1]) : 0;
+    if (seconds <= 0 || rounds < 0) {
+        return 2;
+    }
+    const std::string text{std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()};
+
+    try {
+        constexpr auto ecc = qrcodegen::QrCode::Ecc::MEDIUM;
+        std::vector<qrcodegen::QrCode> codes;
+        if (text.size() <= qrexport::maxBytesPerCode(qrcodegen::QrCode::MAX_VERSION, ecc)) {
+            codes.push_back(qrcodegen::QrCode::encodeText(text.c_str(), ecc));
+        } else {
+            codes = qrexport::encodeParts(text, 10, ecc);
+        }
+        enableTerminalOutput();
+
+        // Every frame is rendered up front; showing one is then a single write. Later frames
+        // move the cursor back up over the previous one, which has the same number of lines.
+        std::vector<std::string> frames;
+        for (std::size_t i = 0; i < codes.size(); ++i) {
+            std::string frame = qrexport::renderTerminal(codes[i], 2, style);
+            if (codes.size() > 1) {
+                frame += "part " + std::to_string(i + 1) + "/" + std::to_string(codes.size()) + "\x1b[K\n";
+            }
+            frames.push_back(std::move(frame));
+        }
+        const std::size_t lines = static_cast<std::size_t>(std::count(frames[0].begin(), frames[0].end(), '\n'));
+        const std::string cursorUp = "\x1b[" + std::to_string(lines) + "A";
+
+        std::string output;
+        output.reserve(cursorUp.size() + frames[0].size());
+        const int totalRounds = codes.size() == 1 ? 1 : rounds;   // 0: until interrupted
+        for (int round = 0; totalRounds == 0 || round < totalRounds; ++round) {
+            for (std::size_t i = 0; i < frames.size(); ++i) {
+                output.assign(round == 0 && i == 0 ? "" : cursorUp);
+                output += frames[i];
+                std::fwrite(output.data(), 1, output.size(), stdout);
+                std::fflush(stdout);
+                if (codes.size() > 1) {
+                    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+                }
+            }
+        }
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
+
+// pdf <out.pdf> [module-points]: encodes each line of standard input as one code (level M) and
+// lays them out as a vector A4 label sheet with the given module size (default 2 pt).
+int runPdf(int argc, char* argv[]) {
+    if (argc < 1 || argc > 2) {
+        return 2;
+    }
+    qrexport::PdfLayout layout;
+    if (argc > 1) {
+        layout.moduleSize = std::atof(argv[1]);
+        if (layout.moduleSize <= 0) {
+            return 2;
+        }
+    }
+
+    try {
+        std::vector<qrcodegen::QrCode> codes;
+        for (std::string line; std::getline(std::cin, line); ) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            codes.push_back(qrcodegen::QrCode::encodeText(line.c_str(), qrcodegen::QrCode::Ecc::MEDIUM));
+        }
+        if (codes.empty()) {
+            std::fprintf(stderr, "No input lines\n");
+            return 1;
+        }
+        const auto start = Clock::now();
+        const auto pdf = qrexport::encodePdf(codes, layout);
+        const double micros = elapsedMicros(start);
+        if (pdf.empty() || !writeFile(argv[0], pdf)) {
+            std::fprintf(stderr, "Cannot write %s\n", argv[0]);
+            return 1;
+        }
+        std::fprintf(stderr, "%zu codes, %zu bytes, %.2f ms\n", codes.size(), pdf.size(), micros / 1000);
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
+
+// Strips the carriage return of a CRLF line read with std::getline.
+void chompCr(std::string& line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+}
+
+// Command-line names of the mask strategies, in the order of QrCode::MaskStrategy.
+constexpr const char* maskStrategyNames[] = {"exact", "fast", "fixed"};
+
+[[nodiscard]]
+bool parseMaskStrategy(const char* name, qrcodegen::QrCode::MaskStrategy& strategy) {
+    for (std::size_t i = 0; i < std::size(maskStrategyNames); ++i) {
+        if (std::strcmp(name, maskStrategyNames[i]) == 0) {
+            strategy = static_cast<qrcodegen::QrCode::MaskStrategy>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Names batch image `index` (from 0) 000001.png and so on.
+[[nodiscard]]
+std::string numberedName(std::size_t index) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%06zu.png", index + 1);
+    return name;
+}
+
+// Where batch images go: numbered files in a directory, written by background threads, or the
+// entries of one .zip or .tar archive with an optional <archive>.index of payload hashes.
+// deliver() is thread safe.
+class BatchOutput final {
+public:
+    BatchOutput(const std::filesystem::path& target, qrsink::SyncPolicy sync, bool index)
+        : directory_{target} {
+        const std::filesystem::path extension = target.extension();
+        if (extension == ".zip" || extension == ".tar") {
+            std::filesystem::path indexPath;
+            if (index) {
+                indexPath = target;
+                indexPath += ".index";
+            }
+            archive_ = std::make_unique<qrsink::ArchiveWriter>(
+                target, extension == ".zip" ? qrsink::ArchiveFormat::Zip : qrsink::ArchiveFormat::Tar, indexPath);
+            hashed_ = index;
+        } else {
+            std::error_code ec;
+            std::filesystem::create_directories(directory_, ec);
+            if (ec) {
+                throw std::runtime_error("Cannot create " + directory_.string());
+            }
+            files_ = std::make_unique<qrsink::AsyncFileWriter>(2, sync);
+        }
+    }
+
+    // Records the payload hash for the index; must precede delivery of the same image.
+    void noteHash(std::size_t index, std::uint64_t hash) {
+        if (hashed_) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            hashes_.emplace(index, hash);
+        }
+    }
+
+    void deliver(std::size_t index, std::vector<unsigned char>&& png) {
+        std::uint64_t hash = 0;
+        if (hashed_) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto found = hashes_.find(index);
+            hash = found->second;
+            hashes_.erase(found);
+        }
+        if (png.empty()) {
+            ++unencodable_;
+        } else if (archive_) {
+            archive_->add(numberedName(index), png, hash);
+        } else {
+            files_->write(directory_ / numberedName(index), std::move(png));
+        }
+    }
+
+    // Completes the output, prints a summary and returns whether every image was written.
+    [[nodiscard]]
+    bool finish() {
+        bool ok = unencodable_ == 0;
+        if (archive_) {
+            archive_->finish();
+            std::fprintf(stderr, "%zu entries, %llu archive bytes", archive_->entries(),
+                         static_cast<unsigned long long>(archive_->size()));
+        } else {
+            const auto written = files_->finish();
+            std::fprintf(stderr, "%zu files, %llu bytes in %zu write batches, %zu failed",
+                         written.files, static_cast<unsigned long long>(written.bytes), written.batches, written.failed);
+            ok = ok && written.failed == 0;
+        }
+        std::fprintf(stderr, ", %zu payloads too long for one code\n", unencodable_.load());
+        return ok;
+    }
+
+private:
+    std::filesystem::path                    directory_;
+    std::unique_ptr<qrsink::AsyncFileWriter> files_;
+    std::unique_ptr<qrsink::ArchiveWriter>   archive_;
+    bool                                     hashed_ = false;
+    std::mutex                               mutex_;
+    std::unordered_map<std::size_t, std::uint64_t> hashes_;    // Images not yet delivered
+    std::atomic<std::size_t>                 unencodable_{0};
+};
+
+// batch --stream: payloads flow through the staged pipeline as they are read, so input of any
+// length runs in bounded memory, and the output writes overlap encoding and compression.
+int runBatchStream(BatchOutput& output, const qrbatch::BatchOptions& options, unsigned threads) {
+    qrbatch::PipelineOptions pipeline;
+    pipeline.encodeThreads   = threads;
+    pipeline.compressThreads = threads;
+    std::size_t count = 0;  // The source is called in order and under a lock, so this is its index
+    const auto start = Clock::now();
+    const auto stats = qrbatch::streamBatch(
+        [&](std::string& payload) {
+            if (!std::getline(std::cin, payload)) {
+                return false;
+            }
+            chompCr(payload);
+            output.noteHash(count++, qrdelta::contentHash(payload));
+            return true;
+        },
+        options, pipeline,
+        [&](std::size_t index, std::vector<unsigned char>&& png) { output.deliver(index, std::move(png)); });
+    const bool ok = output.finish();
+    const double micros = elapsedMicros(start);
+    if (stats.items == 0) {
+        std::fprintf(stderr, "No input lines\n");
+        return 1;
+    }
+
+    std::fprintf(stderr, "%zu codes, %.2f ms\n", stats.items, micros / 1000);
+    std::fprintf(stderr, "busy ms: encode %.1f, raster %.1f, compress %.1f, sink %.1f\n",
+                 stats.encodeSeconds * 1000, stats.rasterSeconds * 1000,
+                 stats.compressSeconds * 1000, stats.sinkSeconds * 1000);
+    return ok ? 0 : 1;
+}
+
+// batch <out-dir|out.zip|out.tar> [threads] [--stream] [--sync | --sync-full] [--index] [--meta |
+// --meta-payload] [--mask exact|fast|fixed] [--model <file>]: encodes
+// each line of standard input as one code (level M) and writes it as 000001.png and so on, into
+// a directory or a single archive. By default all lines are read first and run on the
+// work-stealing scheduler, which then reports how busy each worker was; --stream runs them
+// through the staged pipeline instead (threads then applies to encoding and to compression).
+// Directory output is written by background threads; --sync flushes each file to disk, and
+// --sync-full also the directory. --index writes <archive>.index, mapping payload hashes to
+// entry offsets. --meta embeds the payload hash in each PNG, --meta-payload the payload too.
+// --mask picks the mask strategy (default exact; see bench-mask for what the others cost).
+// --model loads the cost model (from bench-cost) that orders the jobs on the scheduler.
+int runBatch(int argc, char* argv[]) {
+    bool stream = false, index = false;
+    const char* modelPath = nullptr;
+    qrsink::SyncPolicy sync = qrsink::SyncPolicy::None;
+    qrbatch::BatchOptions options;
+    std::vector<const char*> args;
+    for (int i = 0; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--stream") == 0) {
+            stream = true;
+        } else if (std::strcmp(argv[i], "--sync") == 0) {
+            sync = qrsink::SyncPolicy::Files;
+        } else if (std::strcmp(argv[i], "--sync-full") == 0) {
+            sync = qrsink::SyncPolicy::Full;
+        } else if (std::strcmp(argv[i], "--index") == 0) {
+            index = true;
+        } else if (std::strcmp(argv[i], "--meta") == 0) {
+            options.embed = qrbatch::BatchOptions::Embed::Hash;
+        } else if (std::strcmp(argv[i], "--meta-payload") == 0) {
+            options.embed = qrbatch::BatchOptions::Embed::HashAndPayload;
+        } else if (std::strcmp(argv[i], "--mask") == 0) {
+            if (i + 1 == argc || !parseMaskStrategy(argv[++i], options.mask)) {
+                return 2;
+            }
+        } else if (std::strcmp(argv[i], "--model") == 0) {
+            if (i + 1 == argc) {
+                return 2;
+            }
+            modelPath = argv[++i];
+        } else if (std::strncmp(argv[i], "--", 2) == 0) {
+            return 2;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.empty() || args.size() > 2) {
+        return 2;
+    }
+    const int threads = args.size() > 1 ? std::atoi(args[1]) : 0;
+    if (threads < 0) {
+        return 2;
+    }
+
+    try {
+        if (modelPath != nullptr) {
+            options.costModel = qrcost::CostModel::load(modelPath);
+        }
+        BatchOutput output(args[0], sync, index);
+        if (stream) {
+            return runBatchStream(output, options, static_cast<unsigned>(threads));
+        }
+
+        std::vector<std::string> payloads;
+        for (std::string line; std::getline(std::cin, line); ) {
+            chompCr(line);
+            output.noteHash(payloads.size(), qrdelta::contentHash(line));
+            payloads.push_back(std::move(line));
+        }
+        if (payloads.empty()) {
+            std::fprintf(stderr, "No input lines\n");
+            return 1;
+        }
+
+        qrbatch::Scheduler scheduler(static_cast<unsigned>(threads));
+        const auto start = Clock::now();
+        qrbatch::encodeBatch(scheduler, payloads, options,
+                             [&](std::size_t i, std::vector<unsigned char>&& png) { output.deliver(i, std::move(png)); });
+        const bool ok = output.finish();
+        const double micros = elapsedMicros(start);
+
+        std::fprintf(stderr, "%zu codes, %.2f ms\n", payloads.size(), micros / 1000);
+        std::fprintf(stderr, "%-7s %8s %8s %12s\n", "worker", "tasks", "stolen", "utilisation");
+        const auto stats = scheduler.stats();
+        for (std::size_t i = 0; i < stats.size(); ++i) {
+            std::fprintf(stderr, "%-7zu %8llu %8llu %11.1f%%\n", i,
+                         static_cast<unsigned long long>(stats[i].tasks),
+                         static_cast<unsigned long long>(stats[i].stolen),
+                         100.0 * stats[i].busySeconds * 1e6 / micros);
+        }
+        return ok ? 0 : 1;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
+
+// cache <out.qrc>: encodes each line of standard input as one code (level M) and stores the
+// results as serialised records, for rendering later without encoding again. Lines too long for
+// one code are reported and left out.
+int runCache(int argc, char* argv[]) {
+    if (argc != 1) {
+        return 2;
+    }
+    std::vector<unsigned char> records;
+    std::size_t lineNumber = 0, count = 0;
+    const auto start = Clock::now();
+    for (std::string line; std::getline(std::cin, line); ) {
+        chompCr(line);
+        ++lineNumber;
+        const auto result = qrcodegen::QrCode::tryEncodeSegments(
+            qrcodegen::QrSegment::makeSegments(line.c_str()), qrcodegen::QrCode::Ecc::MEDIUM);
+        if (!result) {
+            std::fprintf(stderr, "Line %zu does not fit one code\n", lineNumber);
+            continue;
+        }
+        qrcache::appendRecord(records, result.value());
+        ++count;
+    }
+    const double micros = elapsedMicros(start);
+    if (!writeFile(argv[0], records)) {
+        std::fprintf(stderr, "Cannot write %s\n", argv[0]);
+        return 1;
+    }
+    std::fprintf(stderr, "%zu codes, %zu bytes, encoded in %.2f ms\n", count, records.size(), micros / 1000);
+    return count == lineNumber ? 0 : 1;
+}
+
+// render <in.qrc> <out-dir|out.zip|out.tar>: renders every record of a cache file as a PNG like
+// batch does, reading the records in place from the mapped file instead of encoding again.
+int runRender(int argc, char* argv[]) {
+    if (argc != 2) {
+        return 2;
+    }
+    try {
+        const qrcache::MappedFile file(argv[0]);
+        const auto start = Clock::now();
+        const auto codes = qrcache::parseRecords(file.data(), file.size());
+        if (codes.empty()) {
+            std::fprintf(stderr, "No codes in %s\n", argv[0]);
+            return 1;
+        }
+        BatchOutput output(argv[1], qrsink::SyncPolicy::None, false);
+        const qrbatch::BatchOptions options;
+        {
+            qrbatch::Scheduler scheduler;
+            for (std::size_t i = 0; i < codes.size(); ++i) {
+                scheduler.spawn([&, i] {
+                    const qrcache::CodeView& qr = codes[i];
+                    const unsigned side = static_cast<unsigned>((qr.getSize() + options.border * 2) * options.scale);
+                    output.deliver(i, qrexport::encodeGreyscalePng(
+                        qrexport::renderGreyscale(qr, options.scale, options.border), side));
+                });
+            }
+            scheduler.wait();
+        }
+        const bool ok = output.finish();
+        std::fprintf(stderr, "%zu codes, %.2f ms\n", codes.size(), elapsedMicros(start) / 1000);
+        return ok ? 0 : 1;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
+
+// scan <dir> [--dups] [--payload]: indexes the PNGs under a directory by the payload hash their
+// text chunks carry, reading chunk headers only. Prints "<hash> <side> <path>" per image, or with
+// --dups only the images whose payload was generated before; --payload appends the payload.
+int runScan(int argc, char* argv[]) {
+    bool dups = false, payloads = false;
+    std::vector<const char*> args;
+    for (int i = 0; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--dups") == 0) {
+            dups = true;
+        } else if (std::strcmp(argv[i], "--payload") == 0) {
+            payloads = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.size() != 1) {
+        return 2;
+    }
+
+    std::size_t scanned = 0, tagged = 0, duplicates = 0;
+    std::unordered_map<std::uint64_t, std::string> firstSeen;
+    const auto start = Clock::now();
+    std::error_code ec;
+    for (std::filesystem::recursive_directory_iterator it(args[0], ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() != ".png" || !it->is_regular_file(ec)) {
+            continue;
+        }
+        ++scanned;
+        const std::string path = it->path().string();
+        qrexport::PngMetadata metadata;
+        unsigned width = 0, height = 0;
+        try {
+            if (!qrexport::readPngMetadata(path, payloads, metadata, width, height)) {
+                continue;
+            }
+        }
+        catch (const std::exception& e) {  // Such as std::bad_alloc; one bad file does not end the scan
+            std::fprintf(stderr, "%s: %s\n", path.c_str(), e.what());
+            continue;
+        }
+        ++tagged;
+        const auto seen = firstSeen.emplace(metadata.payloadHash, path);
+        const bool duplicate = !seen.second;
+        duplicates += duplicate ? 1 : 0;
+        if (dups && !duplicate) {
+            continue;
+        }
+        std::printf("%016llx %u %s", static_cast<unsigned long long>(metadata.payloadHash), width, path.c_str());
+        if (dups) {
+            std::printf(" same as %s", seen.first->second.c_str());
+        }
+        if (payloads) {
+            std::printf(" %s", metadata.payload.c_str());
+        }
+        std::printf("\n");
+    }
+    if (ec) {
+        std::fprintf(stderr, "Cannot scan %s\n", args[0]);
+        return 1;
+    }
+    const double micros = elapsedMicros(start);
+    std::fprintf(stderr, "%zu PNG files, %zu with a payload hash, %zu duplicates, %.2f ms (%.0f files/s)\n",
+                 scanned, tagged, duplicates, micros / 1000, micros > 0 ? scanned * 1e6 / micros : 0.0);
+    return 0;
+}
+
+// Simulated screen-to-camera channel: box blur, then crosstalk between the colour
+// channels, then Gaussian sensor noise. Operates in place on interleaved 8-bit pixels.
+class ChannelSimulator final {
+public:
+    ChannelSimulator(int blurRadius, double crosstalk, double noiseSigma) noexcept
+        : blurRadius_{blurRadius}
+        , crosstalk_{crosstalk}
+        , noise_{0.0, noiseSigma} {}
+
+    void apply(std::vector<unsigned char>& pixels, unsigned width, unsigned height, int channels) {
+        blur(pixels, width, height, channels);
+        const std::size_t numPixels = static_cast<std::size_t>(width) * height;
+        for (std::size_t i = 0; i < numPixels; ++i) {
+            unsigned char* px = &pixels[i * static_cast<std::size_t>(channels)];
+            const double r = px[0], g = px[1], b = px[2];
+            const double mixed[3] = {
+                r * (1 - 2 * crosstalk_) + (g + b) * crosstalk_,
+                g * (1 - 2 * crosstalk_) + (r + b) * crosstalk_,
+                b * (1 - 2 * crosstalk_) + (r + g) * crosstalk_,
+            };
+            for (int c = 0; c < 3; ++c) {
+                px[c] = static_cast<unsigned char>(std::clamp(mixed[c] + noise_(rng_), 0.0, 255.0));
+            }
+        }
+    }
+
+private:
+    int blurRadius_;
+    double crosstalk_;
+    std::normal_distribution<double> noise_;
+    std::mt19937 rng_{12345};
+
+    void blur(std::vector<unsigned char>& pixels, unsigned width, unsigned height, int channels) const {
+        if (blurRadius_ <= 0) {
+            return;
+        }
+        const std::vector<unsigned char> src = pixels;
+        const int w = static_cast<int>(width), h = static_cast<int>(height);
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                for (int c = 0; c < 3; ++c) {
+                    int sum = 0, count = 0;
+                    for (int yy = std::max(y - blurRadius_, 0); yy <= std::min(y + blurRadius_, h - 1); ++yy) {
+                        for (int xx = std::max(x - blurRadius_, 0); xx <= std::min(x + blurRadius_, w - 1); ++xx) {
+                            sum += src[(static_cast<std::size_t>(yy) * width + xx) * channels + c];
+                            ++count;
+                        }
+                    }
+                    pixels[(static_cast<std::size_t>(y) * width + x) * channels + c] =
+                        static_cast<unsigned char>(sum / count);
+                }
+            }
+        }
+    }
+};
+
+[[nodiscard]]
+long countModuleErrors(const qrcodegen::QrCode& qr, const std::vector<bool>& sampled) {
+    const int size = qr.getSize();
+    long errors = 0;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            errors += qr.getModule(x, y) != sampled[static_cast<std::size_t>(y) * size + x] ? 1 : 0;
+        }
+    }
+    return errors;
+}
+
+[[nodiscard]]
+qrcodegen::QrCode makeRandomCode(int version, qrcodegen::QrCode::Ecc ecc, std::size_t len, std::mt19937& rng) {
+    std::vector<std::uint8_t> data(len);
+    for (auto& b : data) {
+        b = static_cast<std::uint8_t>(rng());
+    }
+    const auto segs = std::vector<qrcodegen::QrSegment>{qrcodegen::QrSegment::makeBytes(data)};
+    return qrcodegen::QrCode::encodeSegments(segs, ecc, version, version, -1, false);
+}
+
+// bench-rgb [frames] [noise-sigma] [crosstalk]: compares mono and colour-multiplexed frames
+// through the simulated channel, reporting payload per frame, module error rate, the share
+// of frames recovered with no module errors, and render and recovery cost.
+int runBenchRgb(int argc, char* argv[]) {
+    const int frames        = argc > 0 ? std::atoi(argv[0]) : 50;
+    const double noiseSigma = argc > 1 ? std::atof(argv[1]) : 12.0;
+    const double crosstalk  = argc > 2 ? std::atof(argv[2]) : 0.08;
+    if (frames <= 0) {
+        return 2;
+    }
+    constexpr int scale = 4, border = 4, blurRadius = 1;
+    constexpr auto ecc = qrcodegen::QrCode::Ecc::MEDIUM;
+
+    std::printf("frames=%d noise=%.1f crosstalk=%.2f scale=%d blur=%d ecc=M\n",
+                frames, noiseSigma, crosstalk, scale, blurRadius);
+    std::printf("%-4s %-6s %10s %11s %9s %11s %12s\n",
+                "ver", "mode", "bytes/frm", "module err", "clean", "render us", "recover us");
+
+    std::mt19937 rng{42};
+    for (const int version : {5, 10, 20}) {
+        const std::size_t capacity = qrexport::maxBytesPerCode(version, ecc);
+        for (const bool colour : {false, true}) {
+            ChannelSimulator channel{blurRadius, crosstalk, noiseSigma};
+            const int numLayers = colour ? 3 : 1;
+            long errors = 0, modules = 0;
+            int cleanFrames = 0;
+            std::size_t payload = 0;
+            double renderMicros = 0, recoverMicros = 0;
+
+            for (int f = 0; f < frames; ++f) {
+                std::vector<qrcodegen::QrCode> codes;
+                for (int i = 0; i < numLayers; ++i) {
+                    codes.push_back(makeRandomCode(version, ecc, capacity, rng));
+                }
+                payload = capacity * static_cast<std::size_t>(numLayers);
+
+                auto start = Clock::now();
+                const auto png = colour
+                    ? qrexport::encodeColorPng({&codes[0], &codes[1], &codes[2]}, scale, border)
+                    : qrexport::encodePng(codes[0], scale, border);
+                renderMicros += elapsedMicros(start);
+
+                std::vector<unsigned char> pixels;
+                unsigned width = 0, height = 0;
+                if (lodepng::decode(pixels, width, height, png, LCT_RGB) != 0u) {
+                    std::fprintf(stderr, "Rendered PNG failed to decode\n");
+                    return 1;
+                }
+                channel.apply(pixels, width, height, 3);
+
+                start = Clock::now();
+                bool clean = true;
+                for (int i = 0; i < numLayers; ++i) {
+                    const auto& qr = codes[static_cast<std::size_t>(i)];
+                    const auto sampled = qrexport::sampleModules(pixels, width, 3, i, qr.getSize(), scale, border);
+                    const long e = countModuleErrors(qr, sampled);
+                    errors  += e;
+                    modules += static_cast<long>(qr.getSize()) * qr.getSize();
+                    clean = clean && e == 0;
+                }
+                recoverMicros += elapsedMicros(start);
+                cleanFrames += clean ? 1 : 0;
+            }
+
+            std::printf("%-4d %-6s %10zu %10.4f%% %8.1f%% %11.1f %12.1f\n",
+                        version, colour ? "colour" : "mono", payload,
+                        100.0 * static_cast<double>(errors) / static_cast<double>(modules),
+                        100.0 * cleanFrames / frames, renderMicros / frames, recoverMicros / frames);
+        }
+    }
+    return 0;
+}
+
+// A code that the compiler builds, masking included, so that it lands in read-only data with
+// no encoding at startup. The assertions pin the result; bench-fixed checks it against the
+// run-time encoder too.
+constexpr char libraryUrl[] = "https://www.nayuki.io/page/qr-code-generator-library";
+constexpr auto libraryCode = qrcodegen::QrCodeFixed<4, qrcodegen::QrCode::Ecc::MEDIUM>::encodeText(libraryUrl);
+static_assert(libraryCode.getSize() == 33 && libraryCode.getMask() == 2, "Unexpected format or mask");
+static_assert(libraryCode.getModule(9, 13) && !libraryCode.getModule(16, 24)
+              && libraryCode.getModule(30, 13) && !libraryCode.getModule(18, 13), "Unexpected data modules");
+static_assert(sizeof libraryCode <= 33 * 33 + sizeof(int) * 2, "Code is more than its modules and mask");
+
+// bench-segments [rounds]: times QrSegment::makeSegments on the largest payload of each mode
+// that fits a version 40-L code (7089 digits, 4296 alphanumeric characters, 2953 bytes), the
+// fastest of `rounds` runs (default 200), and reports the time per 100 bytes of text.
+int runBenchSegments(int argc, char* argv[]) {
+    if (argc > 1) {
+        return 2;
+    }
+    const int rounds = argc > 0 ? std::atoi(argv[0]) : 200;
+    if (rounds <= 0) {
+        return 2;
+    }
+    using qrcodegen::QrCode;
+    using qrcodegen::QrSegment;
+    std::mt19937 rng{42};
+    constexpr const char* alphanumeric = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
+    const std::pair<const char*, const QrSegment::Mode*> modes[] = {
+        {"numeric", &QrSegment::Mode::NUMERIC}, {"alnum", &QrSegment::Mode::ALPHANUMERIC}, {"byte", &QrSegment::Mode::BYTE}};
+    std::printf("%-8s %6s %9s %10s %11s\n", "mode", "chars", "data bits", "us/call", "us/100 B");
+    for (const auto& [name, mode] : modes) {
+        // Random characters of the mode; byte mode text is printable ASCII with lowercase letters
+        std::string text(static_cast<std::size_t>(QrCode::getMaxPayload(QrCode::MAX_VERSION, QrCode::Ecc::LOW, *mode)), ' ');
+        for (auto& c : text) {
+            c = mode == &QrSegment::Mode::NUMERIC ? static_cast<char>('0' + rng() % 10)
+              : mode == &QrSegment::Mode::ALPHANUMERIC ? alphanumeric[rng() % 45]
+              : static_cast<char>('a' + rng() % 26);
+        }
+        double micros = 1e18;
+        std::size_t bits = 0;
+        for (int round = 0; round < rounds; ++round) {
+            const auto start = Clock::now();
+            const auto segs = QrSegment::makeSegments(text.c_str());
+            micros = std::min(micros, elapsedMicros(start));
+            bits = segs.at(0).getData().size();
+        }
+        std::printf("%-8s %6zu %9zu %10.2f %11.3f\n", name, text.size(), bits, micros,
+                    micros * 100 / static_cast<double>(text.size()));
+    }
+    return 0;
+}
+
+// Encodes `count` random byte payloads of random length in the format of Fixed with both
+// encoders, every eighth with a forced mask and the rest with the automatic choice, and prints
+// the time per code of each. Returns false if any code differs in a single module.
+template <typename Fixed>
+[[nodiscard]]
+bool benchFixedFormat(int count, std::mt19937& rng) {
+    constexpr int version = Fixed::getVersion();
+    constexpr auto ecc = Fixed::getErrorCorrectionLevel();
+    const std::size_t capacity = qrexport::maxBytesPerCode(version, ecc);
+    std::vector<std::vector<qrcodegen::QrSegment>> inputs;
+    std::vector<int> masks;
+    for (int i = 0; i < count; ++i) {
+        std::vector<std::uint8_t> payload(1 + rng() % capacity);
+        for (auto& b : payload) {
+            b = static_cast<std::uint8_t>(rng());
+        }
+        inputs.push_back({qrcodegen::QrSegment::makeBytes(payload)});
+        masks.push_back(i % 8 == 0 ? static_cast<int>(rng() % 8) : -1);
+    }
+
+    std::vector<qrcodegen::QrCode> general;
+    general.reserve(inputs.size());
+    auto start = Clock::now();
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        general.push_back(qrcodegen::QrCode::encodeSegments(inputs[i], ecc, version, version, masks[i], false));
+    }
+    const double generalMicros = elapsedMicros(start);
+
+    std::vector<Fixed> fixed;
+    fixed.reserve(inputs.size());
+    start = Clock::now();
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        fixed.push_back(Fixed::encodeSegments(inputs[i], masks[i]));
+    }
+    const double fixedMicros = elapsedMicros(start);
+
+    std::size_t mismatches = 0;
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        bool same = general[i].getMask() == fixed[i].getMask();
+        for (int y = 0; same && y < Fixed::SIZE; ++y) {
+            for (int x = 0; same && x < Fixed::SIZE; ++x) {
+                same = general[i].getModule(x, y) == fixed[i].getModule(x, y);
+            }
+        }
+        mismatches += same ? 0 : 1;
+    }
+    std::printf("%-4d %-3c %6d %12.2f %12.2f %8.2fx %11zu\n", version, "LMQH"[static_cast<int>(ecc)], count,
+                generalMicros / count, fixedMicros / count, generalMicros / fixedMicros, mismatches);
+    return mismatches == 0;
+}
+
+// bench-fixed [codes]: encodes `codes` random byte payloads (default 2000) as version 4-M and
+// 10-Q codes both with QrCode, version and level pinned, and with the QrCodeFixed specialisation
+// of each format, checks that every module agrees and compares the time per code. Also checks
+// a code built at compile time against QrCode::encodeText and reports its size.
+int runBenchFixed(int argc, char* argv[]) {
+    if (argc > 1) {
+        return 2;
+    }
+    const int count = argc > 0 ? std::atoi(argv[0]) : 2000;
+    if (count <= 0) {
+        return 2;
+    }
+    using qrcodegen::QrCode;
+    std::printf("%-4s %-3s %6s %12s %12s %9s %11s\n", "ver", "ecc", "codes", "QrCode us", "fixed us", "speedup",
+                "mismatches");
+    std::mt19937 rng{42};
+    const bool v4 = benchFixedFormat<qrcodegen::QrCodeFixed<4, QrCode::Ecc::MEDIUM>>(count, rng);
+    const bool v10 = benchFixedFormat<qrcodegen::QrCodeFixed<10, QrCode::Ecc::QUARTILE>>(count, rng);
+
+    const auto runTime = QrCode::encodeText(libraryUrl, QrCode::Ecc::MEDIUM);
+    bool same = runTime.getSize() == libraryCode.getSize() && runTime.getMask() == libraryCode.getMask();
+    for (int y = 0; same && y < libraryCode.getSize(); ++y) {
+        for (int x = 0; same && x < libraryCode.getSize(); ++x) {
+            same = runTime.getModule(x, y) == libraryCode.getModule(x, y);
+        }
+    }
+    std::printf("compile-time %d-%c code: %zu bytes of read-only data, %s QrCode::encodeText\n",
+                libraryCode.getVersion(), "LMQH"[static_cast<int>(libraryCode.getErrorCorrectionLevel())],
+                sizeof libraryCode, same ? "matches" : "differs from");
+    if (!v4 || !v10 || !same) {
+        std::fprintf(stderr, "QrCodeFixed does not match QrCode\n");
+        return 1;
+    }
+    return 0;
+}
+
+// diagnose [--each]: encodes each line of standard input (level M) with diagnostics and reports
+// where encode time goes by phase, how full the codes are, how often boostEcl raises the level
+// and which masks win; --each also prints one line per payload.
+int runDiagnose(int argc, char* argv[]) {
+    const bool each = argc == 1 && std::strcmp(argv[0], "--each") == 0;
+    if (argc > 1 || (argc == 1 && !each)) {
+        return 2;
+    }
+    constexpr const char* modeNames[] = {"", "num", "alnum", "", "byte", "", "", "eci", "kanji"};
+
+    std::size_t codes = 0, tooLong = 0, boosted = 0;
+    long long phaseCycles[4] = {};
+    double fill = 0;
+    std::array<std::size_t, 8> maskWins{};
+    if (each) {
+        std::printf("%-4s %-5s %13s %6s %-4s %9s %10s %10s %10s %10s  %s\n", "ver", "ecc", "data bits", "fill",
+                    "mask", "penalty", "segment", "ecc", "placement", "mask", "segments");
+    }
+    for (std::string line; std::getline(std::cin, line); ) {
+        chompCr(line);
+        qrcodegen::EncodeDiagnostics diagnostics;
+        const auto result = qrcodegen::QrCode::tryEncodeSegments(qrcodegen::QrSegment::makeSegments(line.c_str()),
+            qrcodegen::QrCode::Ecc::MEDIUM, qrcodegen::QrCode::MIN_VERSION, qrcodegen::QrCode::MAX_VERSION, -1, true,
+            qrcodegen::QrCode::MaskStrategy::EXACT, &diagnostics);
+        if (!result) {
+            ++tooLong;
+            if (each) {
+                std::printf("too long for one code\n");
+            }
+            continue;
+        }
+        const auto& qr = result.value();
+        ++codes;
+        boosted += diagnostics.chosenEcl != diagnostics.requestedEcl ? 1 : 0;
+        const double codeFill = static_cast<double>(diagnostics.dataUsedBits) / diagnostics.dataCapacityBits;
+        fill += codeFill;
+        ++maskWins[static_cast<std::size_t>(qr.getMask())];
+        const long long cycles[4] = {diagnostics.segmentCycles, diagnostics.eccCycles,
+                                     diagnostics.placementCycles, diagnostics.maskCycles};
+        for (int i = 0; i < 4; ++i) {
+            phaseCycles[i] += cycles[i];
+        }
+        if (each) {
+            std::string segments;
+            for (const auto& seg : diagnostics.segments) {
+                segments += (segments.empty() ? "" : " ") + std::string(modeNames[seg.modeBits]) + ":"
+                          + std::to_string(seg.numChars);
+            }
+            const char eccNames[] = "LMQH";
+            const char levels[] = {eccNames[static_cast<int>(diagnostics.requestedEcl)], '>',
+                                   eccNames[static_cast<int>(diagnostics.chosenEcl)], '\0'};
+            std::printf("%-4d %-5s %6d/%-6d %5.1f%% %-4d %9ld %10lld %10lld %10lld %10lld  %s\n", qr.getVersion(),
+                        diagnostics.chosenEcl != diagnostics.requestedEcl ? levels : levels + 2,
+                        diagnostics.dataUsedBits, diagnostics.dataCapacityBits, 100 * codeFill, qr.getMask(),
+                        diagnostics.maskPenalties[static_cast<std::size_t>(qr.getMask())],
+                        cycles[0], cycles[1], cycles[2], cycles[3], segments.c_str());
+        }
+    }
+    if (codes == 0) {
+        std::fprintf(stderr, "No input lines that fit one code\n");
+        return 1;
+    }
+
+    const long long totalCycles = phaseCycles[0] + phaseCycles[1] + phaseCycles[2] + phaseCycles[3];
+    constexpr const char* phases[] = {"segment", "ecc", "placement", "mask"};
+    std::printf("%zu codes, %zu too long; mean fill %.1f%%, level boosted in %zu\n", codes, tooLong,
+                100 * fill / static_cast<double>(codes), boosted);
+    for (int i = 0; i < 4; ++i) {
+        std::printf("%-10s %14lld cycles %5.1f%%\n", phases[i], phaseCycles[i],
+                    totalCycles > 0 ? 100.0 * static_cast<double>(phaseCycles[i]) / static_cast<double>(totalCycles) : 0.0);
+    }
+    std::printf("mask wins:");
+    for (std::size_t mask = 0; mask < maskWins.size(); ++mask) {
+        std::printf(" %zu:%zu", mask, maskWins[mask]);
+    }
+    std::printf("\n");
+    return tooLong == 0 ? 0 : 1;
+}
+
+// bench-mask [rounds]: encodes each line of standard input (level M) with every mask strategy
+// and reports the time per code, the fastest of `rounds` runs (default 3), and how much higher
+// the penalty of the mask chosen is than that of the best mask, which EXACT always finds: the
+// excess summed over the corpus, the mean per code and the share of codes with the best mask.
+int runBenchMask(int argc, char* argv[]) {
+    if (argc > 1) {
+        return 2;
+    }
+    const int rounds = argc > 0 ? std::atoi(argv[0]) : 3;
+    if (rounds <= 0) {
+        return 2;
+    }
+    using qrcodegen::QrCode;
+    std::vector<std::vector<qrcodegen::QrSegment>> corpus;
+    std::size_t tooLong = 0;
+    for (std::string line; std::getline(std::cin, line); ) {
+        chompCr(line);
+        auto segs = qrcodegen::QrSegment::makeSegments(line.c_str());
+        if (QrCode::getMinVersion(segs, QrCode::Ecc::MEDIUM) == -1) {
+            ++tooLong;
+            continue;
+        }
+        corpus.push_back(std::move(segs));
+    }
+    if (corpus.empty()) {
+        std::fprintf(stderr, "No input lines that fit one code\n");
+        return 1;
+    }
+
+    std::printf("%zu codes, %zu lines too long\n", corpus.size(), tooLong);
+    std::printf("%-8s %10s %9s %14s %13s %9s\n", "strategy", "ms/code", "speedup", "penalty excess", "mean/code",
+                "best mask");
+    std::vector<long> bestPenalties;
+    double exactMicros = 0;
+    for (std::size_t s = 0; s < std::size(maskStrategyNames); ++s) {
+        const auto strategy = static_cast<QrCode::MaskStrategy>(s);
+        std::vector<QrCode> codes;
+        double micros = 1e18;
+        for (int round = 0; round < rounds; ++round) {
+            codes.clear();
+            codes.reserve(corpus.size());
+            const auto start = Clock::now();
+            for (const auto& segs : corpus) {
+                codes.push_back(QrCode::encodeSegments(segs, QrCode::Ecc::MEDIUM, QrCode::MIN_VERSION,
+                                                       QrCode::MAX_VERSION, -1, true, strategy));
+            }
+            micros = std::min(micros, elapsedMicros(start));
+        }
+
+        long long excess = 0, bestTotal = 0;
+        std::size_t bestMasks = 0;
+        for (std::size_t i = 0; i < codes.size(); ++i) {
+            const long penalty = codes[i].getPenaltyScore();
+            if (strategy == QrCode::MaskStrategy::EXACT) {
+                bestPenalties.push_back(penalty);
+                exactMicros = micros;
+            }
+            excess    += penalty - bestPenalties[i];
+            bestTotal += bestPenalties[i];
+            bestMasks += penalty == bestPenalties[i] ? 1 : 0;
+        }
+        const double count = static_cast<double>(codes.size());
+        std::printf("%-8s %10.3f %8.2fx %13.2f%% %13.1f %8.1f%%\n", maskStrategyNames[s], micros / 1000 / count,
+                    exactMicros / micros, 100.0 * static_cast<double>(excess) / static_cast<double>(bestTotal),
+                    static_cast<double>(excess) / count, 100.0 * static_cast<double>(bestMasks) / count);
+    }
+    return 0;
+}
+
+// Prints the hardware event counts of each benchmark stage per unit of the work it does, so
+// that stages of different sizes compare, with IPC.
+void printStageCounters(const char* const names[], const char* const units[], const qrperf::Counts counts[],
+                        const double amounts[], std::size_t numStages) {
+    using qrperf::Event;
+    std::printf("%-9s %-7s %10s %10s %6s %11s %11s %11s\n",
+                "stage", "per", "cycles", "instr", "IPC", "L1d miss", "LLC miss", "br miss");
+    for (std::size_t i = 0; i < numStages; ++i) {
+        std::printf("%-9s %-7s", names[i], units[i]);
+        for (const Event event : {Event::Cycles, Event::Instructions}) {
+            if (counts[i].has(event)) {
+                std::printf(" %10.2f", static_cast<double>(counts[i][event]) / amounts[i]);
+            } else {
+                std::printf(" %10s", "-");
+            }
+        }
+        std::printf(" %6.2f", counts[i].ipc());
+        for (const Event event : {Event::L1dMisses, Event::LlcMisses, Event::BranchMisses}) {
+            if (counts[i].has(event)) {
+                std::printf(" %11.4f", static_cast<double>(counts[i][event]) / amounts[i]);
+            } else {
+                std::printf(" %11s", "-");
+            }
+        }
+        std::printf("\n");
+    }
+}
+
+// bench-cost [model-file] [rounds]: times each stage of encoding random byte payloads that fill
+// every version at level M, rendered at scales 2 and 4, fits a cost model to the timings and
+// writes it (default qrcost.model) for estimate to load. Each time is the fastest of `rounds`
+// runs (default 5). Where hardware counters can be read, one more run of every sample counts
+// cycles, instructions, cache and branch misses per stage, reported per payload byte, module,
+// pixel or image byte.
+int runBenchCost(int argc, char* argv[]) {
+    if (argc > 2) {
+        return 2;
+    }
+    const char* modelPath = argc > 0 ? argv[0] : "qrcost.model";
+    const int rounds      = argc > 1 ? std::atoi(argv[1]) : 5;
+    if (rounds <= 0) {
+        return 2;
+    }
+    constexpr auto ecc = qrcodegen::QrCode::Ecc::MEDIUM;
+    constexpr int border = 4;
+
+    // Stages as measured; the mask stage is reported as the automatic-mask constructor less
+    // the fixed-mask one
+    enum Stage { Segment, Build, AutoMask, Raster, Compress, numStages };
+    qrperf::Counters counters;
+    qrperf::Counts stageCounts[numStages];
+    double stageAmounts[numStages] = {};
+
+    std::printf("%-4s %-5s %6s %10s %10s %10s %10s %11s %9s\n",
+                "ver", "scale", "bytes", "segment us", "build us", "mask us", "raster us", "compress us", "png");
+    std::mt19937 rng{42};
+    std::vector<qrcost::Sample> samples;
+    for (int version = qrcodegen::QrCode::MIN_VERSION; version <= qrcodegen::QrCode::MAX_VERSION; ++version) {
+        std::vector<std::uint8_t> payload(qrexport::maxBytesPerCode(version, ecc));
+        for (auto& b : payload) {
+            b = static_cast<std::uint8_t>(rng());
+        }
+        for (const int scale : {2, 4}) {
+            qrcost::Sample sample{version, scale, border, payload.size(), 1e18, 1e18, 1e18, 1e18, 1e18, 0};
+            double autoMaskNs = 1e18;
+            for (int round = 0; round <= rounds; ++round) {
+                // The extra last round counts events instead of timing, so that the system calls
+                // that start and stop the counters stay out of the timings
+                const bool counting = round == rounds;
+                if (counting && !counters.available()) {
+                    break;
+                }
+                double stageNs[numStages] = {};
+                const auto measure = [&](Stage stage, const auto& body) {
+                    if (counting) {
+                        counters.start();
+                        body();
+                        stageCounts[stage] += counters.stop();
+                    } else {
+                        const auto start = Clock::now();
+                        body();
+                        stageNs[stage] = elapsedMicros(start) * 1000;
+                    }
+                };
+
+                auto level = ecc;
+                int chosenVersion = 0;
+                std::vector<std::uint8_t> codewords;
+                std::optional<qrcodegen::QrCode> fixedMask, qr;
+                std::vector<unsigned char> image, png;
+                measure(Segment, [&] {
+                    codewords = qrcodegen::QrCode::makeDataCodewords(
+                        {qrcodegen::QrSegment::makeBytes(payload)}, level, chosenVersion);
+                });
+                measure(Build, [&] { fixedMask.emplace(chosenVersion, level, codewords, 0); });
+                measure(AutoMask, [&] { qr.emplace(chosenVersion, level, codewords, -1); });
+                const unsigned side = static_cast<unsigned>((qr->getSize() + border * 2) * scale);
+                measure(Raster, [&] { image = qrexport::renderGreyscale(*qr, scale, border); });
+                measure(Compress, [&] { png = qrexport::encodeGreyscalePng(image, side); });
+
+                const double modules = static_cast<double>(qr->getSize()) * qr->getSize();
+                if (counting) {
+                    stageAmounts[Segment]  += static_cast<double>(payload.size());
+                    stageAmounts[Build]    += modules;
+                    stageAmounts[AutoMask] += modules;
+                    stageAmounts[Raster]   += static_cast<double>(side) * side;
+                    stageAmounts[Compress] += static_cast<double>(side) * ((side + 7) / 8);
+                    continue;
+                }
+                sample.segmentNs  = std::min(sample.segmentNs, stageNs[Segment]);
+                sample.buildNs    = std::min(sample.buildNs, stageNs[Build]);
+                autoMaskNs        = std::min(autoMaskNs, stageNs[AutoMask]);
+                sample.rasterNs   = std::min(sample.rasterNs, stageNs[Raster]);
+                sample.compressNs = std::min(sample.compressNs, stageNs[Compress]);
+                sample.pngBytes   = png.size();
+            }
+            sample.maskNs = std::max(autoMaskNs - sample.buildNs, 0.0);
+            std::printf("%-4d %-5d %6zu %10.1f %10.1f %10.1f %10.1f %11.1f %9zu\n",
+                        version, scale, sample.payloadBytes, sample.segmentNs / 1000, sample.buildNs / 1000,
+                        sample.maskNs / 1000, sample.rasterNs / 1000, sample.compressNs / 1000, sample.pngBytes);
+            samples.push_back(sample);
+        }
+    }
+
+    if (counters.available()) {
+        // Mask scoring alone: what the automatic choice counted beyond the fixed-mask build
+        for (std::size_t i = 0; i < qrperf::numEvents; ++i) {
+            auto& value = stageCounts[AutoMask].values[i];
+            value = value > stageCounts[Build].values[i] ? value - stageCounts[Build].values[i] : 0;
+        }
+        constexpr const char* names[] = {"segment", "build", "mask", "raster", "compress"};
+        constexpr const char* units[] = {"byte", "module", "module", "pixel", "img byte"};
+        std::printf("\nhardware counters, one run per sample:\n");
+        printStageCounters(names, units, stageCounts, stageAmounts, numStages);
+    }
+    if (!counters.reason().empty()) {
+        std::printf("\nhardware counters: %s\n", counters.reason().c_str());
+    }
+
+    try {
+        const auto model = qrcost::calibrate(samples);
+        model.save(modelPath);
+
+        // How far the fitted model is from the measurements it was fitted to
+        const qrcost::Estimator estimator{model};
+        double timeError = 0, sizeError = 0;
+        for (const auto& sample : samples) {
+            const auto estimate = estimator.estimate(sample.payloadBytes, qrcodegen::QrSegment::Mode::BYTE, ecc,
+                                                     sample.scale, sample.border);
+            const double measured = sample.segmentNs + sample.buildNs + sample.maskNs + sample.rasterNs + sample.compressNs;
+            timeError += std::abs(estimate.totalNs() - measured) / measured;
+            sizeError += std::abs(static_cast<double>(estimate.pngBytes) - static_cast<double>(sample.pngBytes))
+                       / static_cast<double>(sample.pngBytes);
+        }
+        std::printf("model written to %s; mean error %.1f%% in time, %.1f%% in PNG size\n", modelPath,
+                    100 * timeError / static_cast<double>(samples.size()),
+                    100 * sizeError / static_cast<double>(samples.size()));
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
+
+// estimate [model-file]: prints, for each line of standard input, what batch would make of it
+// (level M, scale 4): version, boosted level, image side, PNG bytes and CPU time, predicted
+// from the cost model (built in, or a file from bench-cost) without encoding anything.
+int runEstimate(int argc, char* argv[]) {
+    if (argc > 1) {
+        return 2;
+    }
+    try {
+        const qrcost::Estimator estimator{argc > 0 ? qrcost::CostModel::load(argv[0]) : qrcost::CostModel{}};
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(std::cin, line); ) {
+            chompCr(line);
+            lines.push_back(std::move(line));
+        }
+
+        const auto start = Clock::now();
+        std::vector<qrcost::Estimate> estimates;
+        estimates.reserve(lines.size());
+        for (const auto& line : lines) {
+            estimates.push_back(estimator.estimate(line, qrcodegen::QrCode::Ecc::MEDIUM));
+        }
+        const double micros = elapsedMicros(start);
+
+        std::printf("%-4s %-3s %5s %9s %9s\n", "ver", "ecc", "side", "png", "cpu us");
+        double totalNs = 0;
+        for (const auto& estimate : estimates) {
+            if (!estimate.fits) {
+                std::printf("too long for one code\n");
+                continue;
+            }
+            std::printf("%-4d %-3c %5u %9zu %9.1f\n", estimate.version, "LMQH"[static_cast<int>(estimate.ecc)],
+                        estimate.imageSide, estimate.pngBytes, estimate.totalNs() / 1000);
+            totalNs += estimate.totalNs();
+        }
+        std::fprintf(stderr, "%zu estimates in %.1f ns each; %.2f ms of encoding predicted\n", estimates.size(),
+                     estimates.empty() ? 0.0 : micros * 1000 / static_cast<double>(estimates.size()), totalNs / 1e6);
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
+
+struct Command {
+    const char* name;
+    const char* usage;
+    int (*run)(int argc, char* argv[]);
+};
+
+constexpr Command commands[] = {
+    {"split-rgb", "split-rgb <colour.png> <out-prefix>", &runSplitRgb},
+    {"bench-rgb", "bench-rgb [frames] [noise-sigma] [crosstalk]", &runBenchRgb},
+    {"bench-cost", "bench-cost [model-file] [rounds]", &runBenchCost},
+    {"bench-segments", "bench-segments [rounds]", &runBenchSegments},
+    {"bench-fixed", "bench-fixed [codes]", &runBenchFixed},
+    {"bench-mask", "bench-mask [rounds]  (one payload per line on stdin)", &runBenchMask},
+    {"diagnose",  "diagnose [--each]  (one payload per line on stdin)", &runDiagnose},
+    {"estimate",  "estimate [model-file]  (one payload per line on stdin)", &runEstimate},
+    {"apng",      "apng <out.png> [fps] [version]  (text on stdin)", &runApng},
+    {"sheet",     "sheet <out.png> [columns] [scale]  (one payload per line on stdin)", &runSheet},
+    {"pdf",       "pdf <out.pdf> [module-points]  (one payload per line on stdin)", &runPdf},
+    {"batch",     "batch <out-dir|out.zip|out.tar> [threads] [--stream] [--sync|--sync-full] [--index] [--meta|--meta-payload] [--mask exact|fast|fixed] [--model <file>]  (one payload per line on stdin)", &runBatch},
+    {"cache",     "cache <out.qrc>  (one payload per line on stdin)", &runCache},
+    {"render",    "render <in.qrc> <out-dir|out.zip|out.tar>", &runRender},
+    {"scan",      "scan <dir> [--dups] [--payload]", &runScan},
+    {"micro",     "micro <out.png> [scale] | micro --check  (text on stdin)", &runMicro},
+    {"pack",      "pack <out.png> [--stats]  (text on stdin)", &runPack},
+    {"unpack",    "unpack <payload-file> [out]", &runUnpack},
+    {"delta",     "delta <out.png>  (text on stdin)", &runDelta},
+    {"apply",     "apply <payload-file> [out]", &runApply},
+    {"term",      "term [--ansi] [seconds] [rounds]  (text on stdin)", &runTerm},
+};
+
+void printUsage() {
+    std::fprintf(stderr, "Usage:\n");
+    for (const Command& cmd : commands) {
+        std::fprintf(stderr, "  qrtool %s\n", cmd.usage);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printUsage();
+        return 2;
+    }
+    for (const Command& cmd : commands) {
+        if (std::strcmp(argv[1], cmd.name) == 0) {
+            const int status = cmd.run(argc - 2, argv + 2);
+            if (status == 2) {
+                printUsage();
+            }
+            return status;
+        }
+    }
+    printUsage();
+    return 2;
+}